@@ -0,0 +1,86 @@
+#pragma once
+
+#include "header.h"
+
+//A contiguous array of plain data that either owns its elements, growing like a vector while a scene is built,
+//or refers to elements stored somewhere else, e.g. in a memory-mapped scene cache, without copying them
+//Element access is the same either way, so the code that intersects rays does not care where the data lives
+template<class T>
+class Array
+{
+public:
+	Array():
+		_data(NULL),
+		_size(0)
+	{
+	}
+
+	//Add an element to the end. If the array referred to elements elsewhere it takes a copy of them first
+	void push_back(const T &value)
+	{
+		TakeOwnership();
+		_owned.push_back(value);
+		Update();
+	}
+
+	void reserve(size_t count)
+	{
+		TakeOwnership();
+		_owned.reserve(count);
+		Update();
+	}
+
+	void clear()
+	{
+		_owned.clear();
+		Update();
+	}
+
+	//Replace the contents with the values, which are moved in rather than copied
+	void Assign(vector<T> &values)
+	{
+		_owned.swap(values);
+		values.clear();
+		Update();
+	}
+
+	//Refer to elements stored elsewhere instead of owning them. The elements are not copied
+	//@data The elements, which must outlive the array (or the next call that changes it)
+	//@size The number of elements
+	void Attach(T *data, size_t size)
+	{
+		_owned.clear();
+		_data = data;
+		_size = size;
+	}
+
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	T *data() { return _data; }
+	const T *data() const { return _data; }
+	T &operator [](size_t i) { return _data[i]; }
+	const T &operator [](size_t i) const { return _data[i]; }
+
+private:
+	Array(const Array &);
+	Array &operator =(const Array &);
+
+	//Copy attached elements into storage the array owns, so that it can grow
+	void TakeOwnership()
+	{
+		if (_data != NULL && _data != _owned.data()) {
+			_owned.assign(_data, _data + _size);
+		}
+	}
+
+	//Point at the owned storage after it has changed
+	void Update()
+	{
+		_data = _owned.empty() ? NULL : &_owned[0];
+		_size = _owned.size();
+	}
+
+	vector<T> _owned; // The elements when the array owns them
+	T *_data; // The first element, either in _owned or elsewhere
+	size_t _size;
+};
@@ -0,0 +1,399 @@
+#include "BVH.h"
+#include "RenderStats.h"
+#include "Timeline.h"
+
+//Number of buckets the centroid range is divided into when looking for the best split
+static const int kNumBins = 16;
+//Leaves are never allowed to hold more objects than this
+static const int kMaxLeafSize = 8;
+//The traversal stack has a fixed size so the tree must never be deeper than this
+static const int kMaxDepth = 64;
+//Cost of visiting a node relative to the cost of intersecting one object
+static const float kTraversalCost = 0.5f;
+
+BVH::BVH():
+	_primitives(NULL)
+{
+}
+
+void BVH::Build(PrimitiveStore &primitives)
+{
+	TimelineScope timelineScope("Build BVH");
+	_nodes.clear();
+	_leaves.clear();
+	_primitives = &primitives;
+
+	vector<BuildEntry> entries;
+	for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+		for (int i = 0; i < primitives.Count(kind); ++i) {
+			BuildEntry entry;
+			entry.primitive.kind = kind;
+			entry.primitive.index = i;
+			entry.bounds = primitives.Bounds(entry.primitive);
+			entry.centre = entry.bounds.Centre();
+			entries.push_back(entry);
+		}
+	}
+	if (entries.empty()) {
+		return;
+	}
+
+	// A binary tree with N leaves has at most 2N - 1 nodes
+	_nodes.reserve(2 * entries.size());
+	_nodes.push_back(Node());
+	Subdivide(0, entries, 0, (int)entries.size(), 1);
+
+	// Give each leaf its own run of each kind, so that the primitives a leaf tests are next to each other in memory
+	vector<int> order[kNumBoundedKinds];
+	for (size_t n = 0; n < _nodes.size(); ++n) {
+		Node &node = _nodes[n];
+		if (node.count == 0) {
+			continue;
+		}
+		Leaf leaf;
+		for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+			leaf.first[kind] = (int)order[kind].size();
+			for (int i = node.first; i < node.first + node.count; ++i) {
+				if (entries[i].primitive.kind == kind) {
+					order[kind].push_back(entries[i].primitive.index);
+				}
+			}
+			leaf.count[kind] = (int)order[kind].size() - leaf.first[kind];
+		}
+		node.first = (int)_leaves.size();
+		_leaves.push_back(leaf);
+	}
+	for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+		primitives.Reorder(kind, order[kind]);
+	}
+}
+
+bool BVH::Validate(const PrimitiveStore &primitives) const
+{
+	// Build always puts the children after their parent, so one pass in order sees each node's depth before its children
+	int numNodes = (int)_nodes.size();
+	vector<int> depth(numNodes, 0);
+	if (numNodes > 0) {
+		depth[0] = 1;
+	}
+	for (int n = 0; n < numNodes; ++n) {
+		const Node &node = _nodes[n];
+		if (depth[n] == 0 || depth[n] > kMaxDepth) {
+			return false;
+		}
+		if (node.count == 0) {
+			if (node.first <= n || node.first >= numNodes - 1) {
+				return false;
+			}
+			depth[node.first] = max(depth[node.first], depth[n] + 1);
+			depth[node.first + 1] = max(depth[node.first + 1], depth[n] + 1);
+			continue;
+		}
+		if (node.first < 0 || node.first >= (int)_leaves.size()) {
+			return false;
+		}
+		const Leaf &leaf = _leaves[node.first];
+		for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+			if (leaf.first[kind] < 0 || leaf.count[kind] < 0 || leaf.count[kind] > primitives.Count(kind) - leaf.first[kind]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void BVH::Subdivide(int nodeIndex, vector<BuildEntry> &entries, int begin, int end, int depth)
+{
+	int count = end - begin;
+
+	BoundingBox bounds, centroidBounds;
+	for (int i = begin; i < end; ++i) {
+		bounds.Grow(entries[i].bounds);
+		centroidBounds.Grow(entries[i].centre);
+	}
+	_nodes[nodeIndex].bounds = bounds;
+	_nodes[nodeIndex].first = begin;
+	_nodes[nodeIndex].count = count;
+
+	if (count <= 1 || depth >= kMaxDepth) {
+		return;
+	}
+
+	// Find the cheapest split plane by binning the object centroids along each axis
+	float leafCost = (float)count;
+	float bestCost = std::numeric_limits<float>::infinity();
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		float lo = centroidBounds.pMin[axis];
+		float hi = centroidBounds.pMax[axis];
+		if (hi - lo < 1e-6f) {
+			continue; // all the centroids are on top of each other along this axis
+		}
+		float scale = kNumBins / (hi - lo);
+
+		BoundingBox binBounds[kNumBins];
+		int binCount[kNumBins] = { 0 };
+		for (int i = begin; i < end; ++i) {
+			int bin = glm::min(kNumBins - 1, (int)((entries[i].centre[axis] - lo) * scale));
+			binBounds[bin].Grow(entries[i].bounds);
+			binCount[bin]++;
+		}
+
+		// Sweep from the right to get the cost of everything to the right of each plane
+		float rightArea[kNumBins];
+		int rightCount[kNumBins];
+		BoundingBox sweep;
+		int sweepCount = 0;
+		for (int bin = kNumBins - 1; bin > 0; --bin) {
+			sweep.Grow(binBounds[bin]);
+			sweepCount += binCount[bin];
+			rightArea[bin] = sweep.SurfaceArea();
+			rightCount[bin] = sweepCount;
+		}
+
+		// Then sweep from the left, the plane after bin i - 1 splits [0, i) from [i, kNumBins)
+		sweep = BoundingBox();
+		sweepCount = 0;
+		for (int bin = 1; bin < kNumBins; ++bin) {
+			sweep.Grow(binBounds[bin - 1]);
+			sweepCount += binCount[bin - 1];
+			if (sweepCount == 0 || rightCount[bin] == 0) {
+				continue;
+			}
+			float cost = sweep.SurfaceArea() * sweepCount + rightArea[bin] * rightCount[bin];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	if (bestAxis < 0) {
+		return; // every centroid is in the same place so there is nothing to split
+	}
+
+	// Convert to the same units as the leaf cost
+	float area = bounds.SurfaceArea();
+	bestCost = kTraversalCost + (area > 0.0f ? bestCost / area : leafCost);
+	if (bestCost >= leafCost && count <= kMaxLeafSize) {
+		return; // cheaper to just test every object in this node
+	}
+
+	// Partition the entries about the chosen plane
+	float lo = centroidBounds.pMin[bestAxis];
+	float scale = kNumBins / (centroidBounds.pMax[bestAxis] - lo);
+	BuildEntry *mid = std::partition(&entries[0] + begin, &entries[0] + end, [=](const BuildEntry &entry) {
+		int bin = glm::min(kNumBins - 1, (int)((entry.centre[bestAxis] - lo) * scale));
+		return bin < bestBin;
+	});
+	int split = (int)(mid - &entries[0]);
+
+	int left = (int)_nodes.size();
+	_nodes.push_back(Node());
+	_nodes.push_back(Node());
+	_nodes[nodeIndex].first = left;
+	_nodes[nodeIndex].count = 0;
+
+	Subdivide(left, entries, begin, split, depth + 1);
+	Subdivide(left + 1, entries, split, end, depth + 1);
+}
+
+bool BVH::Intersect(const Ray &ray, PrimitiveHit &hit) const
+{
+	if (_nodes.empty()) {
+		return false;
+	}
+
+	bool found = false;
+	float tEnter;
+	RT_STAT_ADD(kNodeTests, 1);
+	if (!_nodes[0].bounds.Intersect(ray, hit.time, tEnter)) {
+		return false;
+	}
+
+	// Each level of the tree adds at most one entry to the stack beyond the node being visited
+	int stack[2 * kMaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node &node = _nodes[stack[--stackSize]];
+
+		if (node.count > 0) {
+			// Leaf - test each run of primitives and remember only the earliest collision
+			const Leaf &leaf = _leaves[node.first];
+			for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+				if (leaf.count[kind] > 0 && _primitives->Intersect(kind, ray, leaf.first[kind], leaf.count[kind], hit)) {
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// Interior - visit the nearer child first so that the far one can often be culled
+		float tLeft, tRight;
+		RT_STAT_ADD(kNodeTests, 2);
+		bool hitLeft = _nodes[node.first].bounds.Intersect(ray, hit.time, tLeft);
+		bool hitRight = _nodes[node.first + 1].bounds.Intersect(ray, hit.time, tRight);
+		if (hitLeft && hitRight) {
+			if (tLeft < tRight) {
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+			else {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = node.first;
+		}
+		else if (hitRight) {
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+	return found;
+}
+
+bool BVH::Occluded(const Ray &ray, float tMax) const
+{
+	if (_nodes.empty()) {
+		return false;
+	}
+
+	int stack[2 * kMaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	// Any hit will do, so there is no need to sort the children front to back
+	float tEnter;
+	while (stackSize > 0) {
+		const Node &node = _nodes[stack[--stackSize]];
+		RT_STAT_ADD(kNodeTests, 1);
+		if (!node.bounds.Intersect(ray, tMax, tEnter)) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			const Leaf &leaf = _leaves[node.first];
+			for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+				if (leaf.count[kind] > 0 && _primitives->Occluded(kind, ray, leaf.first[kind], leaf.count[kind], tMax)) {
+					return true;
+				}
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.first + 1;
+		stack[stackSize++] = node.first;
+	}
+	return false;
+}
+
+SimdMask BVH::IntersectPacket(const RayPacket &packet, SimdFloat &time, PrimitiveHit hits[]) const
+{
+	SimdMask found(false);
+	if (_nodes.empty()) {
+		return found;
+	}
+
+	int stack[2 * kMaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	const SimdFloat infinity(std::numeric_limits<float>::infinity());
+	SimdFloat tEnter;
+	while (stackSize > 0) {
+		const Node &node = _nodes[stack[--stackSize]];
+
+		if (node.count > 0) {
+			// Leaf - test each run of primitives against the whole packet
+			const Leaf &leaf = _leaves[node.first];
+			for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+				if (leaf.count[kind] > 0) {
+					found = found | _primitives->IntersectPacket(kind, packet, leaf.first[kind], leaf.count[kind], time, hits);
+				}
+			}
+			continue;
+		}
+
+		// Interior - skip children that none of the rays pass through, and visit first the one that
+		// the rays reach earliest
+		SimdFloat tLeft, tRight;
+		RT_STAT_ADD(kNodeTests, 2 * kSimdWidth);
+		SimdMask hitLeft = _nodes[node.first].bounds.Intersect(packet, time, tLeft);
+		SimdMask hitRight = _nodes[node.first + 1].bounds.Intersect(packet, time, tRight);
+		bool anyLeft = Any(hitLeft);
+		bool anyRight = Any(hitRight);
+		if (anyLeft && anyRight) {
+			float nearestLeft = std::numeric_limits<float>::infinity();
+			float nearestRight = std::numeric_limits<float>::infinity();
+			float lefts[kSimdWidth], rights[kSimdWidth];
+			Select(hitLeft, tLeft, infinity).Store(lefts);
+			Select(hitRight, tRight, infinity).Store(rights);
+			for (int lane = 0; lane < kSimdWidth; ++lane) {
+				nearestLeft = glm::min(nearestLeft, lefts[lane]);
+				nearestRight = glm::min(nearestRight, rights[lane]);
+			}
+			if (nearestLeft < nearestRight) {
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+			else {
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+		else if (anyLeft) {
+			stack[stackSize++] = node.first;
+		}
+		else if (anyRight) {
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+	return found;
+}
+
+SimdMask BVH::OccludedPacket(const RayPacket &packet, const SimdFloat &tMax) const
+{
+	SimdMask blocked(false);
+	if (_nodes.empty()) {
+		return blocked;
+	}
+	// Lanes drop out as soon as they are blocked
+	SimdMask active = tMax > SimdFloat(0.0f);
+
+	int stack[2 * kMaxDepth];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	SimdFloat tEnter;
+	while (stackSize > 0) {
+		const Node &node = _nodes[stack[--stackSize]];
+		RT_STAT_ADD(kNodeTests, kSimdWidth);
+		if (!Any(node.bounds.Intersect(packet, tMax, tEnter) & active)) {
+			continue;
+		}
+
+		if (node.count > 0) {
+			const Leaf &leaf = _leaves[node.first];
+			for (int kind = 0; kind < kNumBoundedKinds; ++kind) {
+				if (leaf.count[kind] == 0) {
+					continue;
+				}
+				blocked = blocked | (_primitives->OccludedPacket(kind, packet, leaf.first[kind], leaf.count[kind], tMax) & active);
+				active = AndNot(active, blocked);
+				if (!Any(active)) {
+					return blocked;
+				}
+			}
+			continue;
+		}
+
+		stack[stackSize++] = node.first + 1;
+		stack[stackSize++] = node.first;
+	}
+	return blocked;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "PrimitiveStore.h"
+#include "BoundingBox.h"
+
+//Bounding volume hierarchy over the bounded primitives in the scene (spheres, triangles and boxes)
+//Built top-down using a binned surface area heuristic (SAH) so that a ray only has to test
+//the handful of primitives near its path rather than every primitive in the scene
+class BVH
+{
+public:
+	BVH();
+
+	//Build the hierarchy over the bounded primitives of a store, replacing any previous contents
+	//The primitives in the store are reordered so that each leaf covers one contiguous run of each kind.
+	//The store must outlive the hierarchy and not change after this
+	//@primitives The primitives to build over
+	void Build(PrimitiveStore &primitives);
+
+	//Use a hierarchy whose arrays have been filled in directly from a scene cache, rather than building one
+	//@primitives The primitives it was built over, in the order that Build left them
+	void Attach(const PrimitiveStore &primitives) { _primitives = &primitives; }
+
+	//Check a hierarchy filled in from a scene cache, so that a damaged cache can not send the traversal out of bounds
+	//@primitives The primitives it was built over
+	//returns false if a node or leaf refers outside the arrays, or the tree is deeper than the traversal stack allows
+	bool Validate(const PrimitiveStore &primitives) const;
+
+	//Find the closest intersection of the ray with the primitives in the hierarchy
+	//@ray The ray that we are testing for intersection
+	//@hit The closest hit so far. Only hits closer than hit.time are reported
+	//returns true if a primitive closer than hit.time is hit
+	bool Intersect(const Ray &ray, PrimitiveHit &hit) const;
+
+	//Test whether any primitive in the hierarchy is hit before tMax
+	//Stops at the first hit found rather than looking for the closest one
+	//@ray The ray that we are testing for intersection
+	//@tMax Hits at or beyond this time along the ray are ignored
+	bool Occluded(const Ray &ray, float tMax) const;
+
+	//Packet version of Intersect, finds the closest hit for each of the rays in the packet
+	//A node is visited if any of the rays passes through it
+	//@packet The rays that we are testing for intersection
+	//@time Per ray, the time of the closest hit so far. Updated where a closer primitive is hit. Rays with a time of 0 or less are ignored
+	//@hits Per ray, set to the closer hit where one is found
+	//returns the lanes in which a closer primitive was hit
+	SimdMask IntersectPacket(const RayPacket &packet, SimdFloat &time, PrimitiveHit hits[]) const;
+
+	//Packet version of Occluded
+	//@packet The rays that we are testing for intersection
+	//@tMax Per ray, hits at or beyond this time along the ray are ignored. Rays with a tMax of 0 or less are ignored
+	//returns the lanes in which something is in the way
+	SimdMask OccludedPacket(const RayPacket &packet, const SimdFloat &tMax) const;
+
+	//Returns true if nothing has been built
+	bool Empty() const { return _nodes.empty(); }
+
+	//Call f on each of the arrays that make up the hierarchy, always in the same order (see PrimitiveStore::ForEachArray)
+	template<class F> void ForEachArray(F &f)
+	{
+		f(_nodes);
+		f(_leaves);
+	}
+
+private:
+	//A node of the tree, either an interior node with two children or a leaf holding some primitives
+	struct Node
+	{
+		BoundingBox bounds;
+		int first; // Interior: index of the left child (the right child follows it). Leaf: index into _leaves
+		int count; // Number of primitives in a leaf, 0 for an interior node
+	};
+
+	//The primitives of a leaf, one run of consecutive primitives in the store for each bounded kind
+	struct Leaf
+	{
+		int first[kNumBoundedKinds];
+		int count[kNumBoundedKinds];
+	};
+
+	//Per-primitive data only needed while building
+	struct BuildEntry
+	{
+		BoundingBox bounds;
+		glm::vec3 centre;
+		PrimitiveRef primitive;
+	};
+
+	//Recursively split the entries [begin, end) below the node at nodeIndex
+	void Subdivide(int nodeIndex, vector<BuildEntry> &entries, int begin, int end, int depth);
+
+	Array<Node> _nodes;
+	Array<Leaf> _leaves;
+	const PrimitiveStore *_primitives;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Ray.h"
+#include "RayPacket.h"
+
+//An axis-aligned bounding volume, used to build the acceleration structure over the scene
+//An empty box has pMin = +infinity and pMax = -infinity so that growing it by anything gives that thing
+class BoundingBox
+{
+public:
+	BoundingBox():
+		pMin(std::numeric_limits<float>::infinity()),
+		pMax(-std::numeric_limits<float>::infinity())
+	{
+	}
+
+	BoundingBox(const glm::vec3 &pMin, const glm::vec3 &pMax):
+		pMin(pMin),
+		pMax(pMax)
+	{
+	}
+
+	glm::vec3 pMin; // The minimum X,Y,Z corner
+	glm::vec3 pMax; // The maximum X,Y,Z corner
+
+	//Enlarge the box so that it contains the point p
+	void Grow(const glm::vec3 &p)
+	{
+		pMin = glm::min(pMin, p);
+		pMax = glm::max(pMax, p);
+	}
+
+	//Enlarge the box so that it contains another box
+	void Grow(const BoundingBox &box)
+	{
+		pMin = glm::min(pMin, box.pMin);
+		pMax = glm::max(pMax, box.pMax);
+	}
+
+	//Returns the centre point of the box
+	glm::vec3 Centre() const { return 0.5f * (pMin + pMax); }
+
+	//Returns the surface area of the box, which is proportional to the chance of a random ray hitting it
+	float SurfaceArea() const
+	{
+		if (pMin.x > pMax.x) {
+			return 0.0f; // empty box
+		}
+		glm::vec3 d = pMax - pMin;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	//Slab test: the times at which the ray crosses the pair of planes bounding the box on each axis, using the
+	//inverse direction of the ray so there are no divisions or branches. The ray is inside the box between the
+	//last plane it enters through and the first it leaves through, so it misses if tEnter > tExit
+	//@ray The ray that we are testing for intersection
+	//@tEnter Set to the time at which the ray enters the box (negative if the origin is inside)
+	//@tExit Set to the time at which the ray leaves the box (negative if the box is behind the ray)
+	void Slabs(const Ray &ray, float &tEnter, float &tExit) const
+	{
+		glm::vec3 t0 = (pMin - ray.origin) * ray.invDirection;
+		glm::vec3 t1 = (pMax - ray.origin) * ray.invDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+
+		tEnter = glm::max(glm::max(tNear.x, tNear.y), tNear.z);
+		tExit = glm::min(glm::min(tFar.x, tFar.y), tFar.z);
+	}
+
+	//Slab test of every ray in the packet against the box, the same as the single ray version
+	void Slabs(const RayPacket &packet, SimdFloat &tEnter, SimdFloat &tExit) const
+	{
+		SimdFloat tNear[3], tFar[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			SimdFloat t0 = (SimdFloat(pMin[axis]) - packet.origin[axis]) * packet.invDirection[axis];
+			SimdFloat t1 = (SimdFloat(pMax[axis]) - packet.origin[axis]) * packet.invDirection[axis];
+			tNear[axis] = Min(t0, t1);
+			tFar[axis] = Max(t0, t1);
+		}
+		tEnter = Max(Max(tNear[0], tNear[1]), tNear[2]);
+		tExit = Min(Min(tFar[0], tFar[1]), tFar[2]);
+	}
+
+	//Test whether the ray passes through the box
+	//@ray The ray that we are testing for intersection
+	//@tMax Only hits closer than this along the ray are of interest
+	//@tEnter Set to the time at which the ray enters the box (may be negative if the origin is inside)
+	//returns true if the ray passes through the box somewhere in [0, tMax)
+	bool Intersect(const Ray &ray, float tMax, float &tEnter) const
+	{
+		float tExit;
+		Slabs(ray, tEnter, tExit);
+		return tEnter <= tExit && tExit >= 0.0f && tEnter < tMax;
+	}
+
+	//Test whether every ray in the packet passes through the box
+	//@packet The rays that we are testing for intersection
+	//@tMax Per ray, only hits closer than this are of interest
+	//@tEnter Set to the time at which each ray enters the box
+	//returns the lanes whose rays pass through the box somewhere in [0, tMax)
+	SimdMask Intersect(const RayPacket &packet, const SimdFloat &tMax, SimdFloat &tEnter) const
+	{
+		SimdFloat tExit;
+		Slabs(packet, tEnter, tExit);
+		return (tEnter <= tExit) & (tExit >= SimdFloat(0.0f)) & (tEnter < tMax);
+	}
+
+	//Find where a ray first hits the surface of the box, which is where it enters, or where it leaves if it
+	//starts inside
+	//@ray The ray that we are testing for intersection
+	//@time Set to the time of the hit
+	//returns true if the ray hits the surface in front of its origin
+	bool HitSurface(const Ray &ray, float &time) const
+	{
+		float tEnter, tExit;
+		Slabs(ray, tEnter, tExit);
+		time = tEnter > 0.0f ? tEnter : tExit;
+		return tEnter <= tExit && time > 0.0f;
+	}
+
+	//Packet version of HitSurface
+	//returns the lanes whose rays hit the surface
+	SimdMask HitSurface(const RayPacket &packet, SimdFloat &time) const
+	{
+		SimdFloat tEnter, tExit;
+		Slabs(packet, tEnter, tExit);
+		time = Select(tEnter > SimdFloat(0.0f), tEnter, tExit);
+		return (tEnter <= tExit) & (time > SimdFloat(0.0f));
+	}
+
+	//Returns the outward normal of the face that a ray hits at the given time, as found by HitSurface
+	//The time is exactly the time that the ray crosses the plane of that face, so the face is found by comparison
+	glm::vec3 SurfaceNormal(const Ray &ray, float time) const
+	{
+		glm::vec3 t0 = (pMin - ray.origin) * ray.invDirection;
+		glm::vec3 t1 = (pMax - ray.origin) * ray.invDirection;
+		glm::vec3 normal(0.0f);
+		for (int axis = 0; axis < 3; ++axis) {
+			if (t0[axis] == time) {
+				normal[axis] = -1.0f;
+				return normal;
+			}
+			if (t1[axis] == time) {
+				normal[axis] = 1.0f;
+				return normal;
+			}
+		}
+		return normal;
+	}
+};
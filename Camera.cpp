@@ -0,0 +1,36 @@
+#include "Camera.h"
+
+Camera::Camera():
+	fov(90.0f),
+	aspect(0.0f),
+	_viewMatrix(1.0f)
+{
+}
+
+void Camera::LookAt(const glm::vec3 &position, const glm::vec3 &target, const glm::vec3 &up)
+{
+	// The columns of the view matrix are the camera's axes in world space followed by its position
+	glm::vec3 forward = glm::normalize(target - position);
+	glm::vec3 right = glm::normalize(glm::cross(forward, up));
+	glm::vec3 trueUp = glm::cross(right, forward);
+	_viewMatrix[0] = glm::vec4(right, 0.0f);
+	_viewMatrix[1] = glm::vec4(trueUp, 0.0f);
+	_viewMatrix[2] = glm::vec4(-forward, 0.0f);
+	_viewMatrix[3] = glm::vec4(position, 1.0f);
+}
+
+CameraRays::CameraRays(const Camera &camera, int width, int height)
+{
+	// The image covers a rectangle 1 unit in front of the camera, whose height is set by the field of view
+	float aspectRatio = camera.aspect > 0.0f ? camera.aspect : (float)width / (float)height;
+	float halfHeight = tan(glm::radians(camera.fov) * 0.5f);
+	float halfWidth = halfHeight * aspectRatio;
+
+	// Directions in camera space, turned into world space. Only the rotation (and any scale) of the view matrix
+	// applies to a direction, the translation is the origin of every ray
+	glm::mat3 rotation(camera.ViewMatrix());
+	_origin = glm::vec3(camera.ViewMatrix() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+	_columnStep = rotation * glm::vec3(2.0f * halfWidth / width, 0.0f, 0.0f);
+	_rowStep = rotation * glm::vec3(0.0f, -2.0f * halfHeight / height, 0.0f);
+	_topLeft = rotation * glm::vec3(-halfWidth, halfHeight, -1.0f) + 0.5f * (_columnStep + _rowStep);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Ray.h"
+
+//A pinhole camera: where it is, which way it looks and how much of the scene it takes in
+//In camera space the camera sits at the origin looking down the negative z axis with y up. The view matrix takes
+//camera space into world space, so any placement can be given, but LookAt covers the usual case
+class Camera
+{
+public:
+	//At the origin looking down the negative z axis, with a 90 degree field of view
+	Camera();
+
+	//Place the camera and turn it to face a point
+	//@position Where the camera is
+	//@target The point that appears in the middle of the image
+	//@up Which way is up in the image. Must not point along the view direction
+	void LookAt(const glm::vec3 &position, const glm::vec3 &target, const glm::vec3 &up = glm::vec3(0.0f, 1.0f, 0.0f));
+
+	//Move the camera without turning it
+	void SetPosition(const glm::vec3 &position) { _viewMatrix[3] = glm::vec4(position, 1.0f); }
+
+	//Place and turn the camera with any transformation from camera space to world space
+	void SetViewMatrix(const glm::mat4 &viewMatrix) { _viewMatrix = viewMatrix; }
+
+	glm::vec3 Position() const { return glm::vec3(_viewMatrix[3]); }
+	const glm::mat4 &ViewMatrix() const { return _viewMatrix; }
+
+	float fov; // The vertical field of view in degrees
+	float aspect; // The width of the view over its height, or 0 to match the shape of the image being rendered
+
+private:
+	glm::mat4 _viewMatrix;
+};
+
+//The primary rays of a camera for an image of a given size
+//Everything that is the same for every pixel is worked out once, so the ray through a pixel only takes one step
+//per column and one per row from the top left pixel, and a normalise
+class CameraRays
+{
+public:
+	//@camera The camera, which is not referred to again afterwards
+	//@width, height The resolution of the image
+	CameraRays(const Camera &camera, int width, int height);
+
+	//Returns the ray through the centre of a pixel, where column 0, row 0 is the top left of the image
+	Ray PrimaryRay(int column, int row) const
+	{
+		return Ray(_origin, glm::normalize(_topLeft + (float)column * _columnStep + (float)row * _rowStep));
+	}
+
+	//Returns the ray through any point of the image, e.g. for several samples within a pixel
+	//@x, y The point in pixels from the top left corner of the image, so (0.5, 0.5) is the centre of the top left pixel
+	Ray RayThrough(float x, float y) const
+	{
+		return Ray(_origin, glm::normalize(_topLeft + (x - 0.5f) * _columnStep + (y - 0.5f) * _rowStep));
+	}
+
+private:
+	glm::vec3 _origin;
+	glm::vec3 _topLeft; // The direction through the centre of the top left pixel, not normalised
+	glm::vec3 _columnStep; // Added to the direction for each column to the right
+	glm::vec3 _rowStep; // Added to the direction for each row down
+};
@@ -0,0 +1,175 @@
+#include "Image.h"
+
+#include <cstdio>
+#include <cstdint>
+
+//Convert a colour channel in [0,1] to a byte
+static unsigned char ToByte(float value)
+{
+	return (unsigned char)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+bool WritePPM(const string &path, int width, int height, const vector<glm::vec3> &pixels)
+{
+	ofstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+	file << "P6\n" << width << ' ' << height << "\n255\n";
+
+	vector<unsigned char> row(3 * width);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const glm::vec3 &color = pixels[y * width + x];
+			row[3 * x + 0] = ToByte(color.x);
+			row[3 * x + 1] = ToByte(color.y);
+			row[3 * x + 2] = ToByte(color.z);
+		}
+		file.write((const char *)&row[0], row.size());
+	}
+	return (bool)file;
+}
+
+bool WritePFM(const string &path, int width, int height, const vector<glm::vec3> &pixels)
+{
+	ofstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+	// A negative scale marks the data as little-endian
+	uint16_t endianTest = 1;
+	bool littleEndian = *(unsigned char *)&endianTest == 1;
+	file << "PF\n" << width << ' ' << height << '\n' << (littleEndian ? "-1.0" : "1.0") << '\n';
+
+	// PFM stores the rows from the bottom of the image up
+	for (int y = height - 1; y >= 0; --y) {
+		file.write((const char *)&pixels[y * width], 3 * sizeof(float) * width);
+	}
+	return (bool)file;
+}
+
+//CRC-32 as used by PNG chunks
+static uint32_t Crc32(uint32_t crc, const unsigned char *data, size_t length)
+{
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if (!tableReady) {
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		tableReady = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < length; ++i) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+//Append a 32-bit big-endian value
+static void PutU32(vector<unsigned char> &out, uint32_t value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+//Write a PNG chunk: length, type, data and the CRC of the type and data
+static void WriteChunk(ofstream &file, const char *type, const vector<unsigned char> &data)
+{
+	vector<unsigned char> chunk;
+	PutU32(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutU32(chunk, Crc32(0, &chunk[4], chunk.size() - 4));
+	file.write((const char *)&chunk[0], chunk.size());
+}
+
+bool WritePNG(const string &path, int width, int height, const vector<glm::vec3> &pixels)
+{
+	ofstream file(path.c_str(), ios::binary);
+	if (!file) {
+		return false;
+	}
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	file.write((const char *)signature, 8);
+
+	vector<unsigned char> header;
+	PutU32(header, width);
+	PutU32(header, height);
+	header.push_back(8); // bit depth
+	header.push_back(2); // colour type RGB
+	header.push_back(0); // compression
+	header.push_back(0); // filter
+	header.push_back(0); // no interlace
+	WriteChunk(file, "IHDR", header);
+
+	// Raw scanlines, each one starts with filter type 0 (none)
+	vector<unsigned char> raw;
+	raw.reserve((size_t)height * (3 * width + 1));
+	for (int y = 0; y < height; ++y) {
+		raw.push_back(0);
+		for (int x = 0; x < width; ++x) {
+			const glm::vec3 &color = pixels[y * width + x];
+			raw.push_back(ToByte(color.x));
+			raw.push_back(ToByte(color.y));
+			raw.push_back(ToByte(color.z));
+		}
+	}
+
+	// Wrap the scanlines in a zlib stream made of uncompressed deflate blocks
+	vector<unsigned char> compressed;
+	compressed.push_back(0x78);
+	compressed.push_back(0x01);
+	size_t offset = 0;
+	do {
+		size_t blockSize = glm::min(raw.size() - offset, (size_t)65535);
+		bool lastBlock = offset + blockSize == raw.size();
+		compressed.push_back(lastBlock ? 1 : 0);
+		compressed.push_back((unsigned char)(blockSize & 0xFF));
+		compressed.push_back((unsigned char)(blockSize >> 8));
+		compressed.push_back((unsigned char)(~blockSize & 0xFF));
+		compressed.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < raw.size());
+
+	// Adler-32 checksum of the uncompressed data
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); ++i) {
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutU32(compressed, (b << 16) | a);
+	WriteChunk(file, "IDAT", compressed);
+
+	WriteChunk(file, "IEND", vector<unsigned char>());
+	return (bool)file;
+}
+
+bool WriteImage(const string &path, int width, int height, const vector<glm::vec3> &pixels)
+{
+	string extension;
+	size_t dot = path.rfind('.');
+	if (dot != string::npos) {
+		extension = path.substr(dot + 1);
+		transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	}
+
+	if (extension == "ppm") {
+		return WritePPM(path, width, height, pixels);
+	}
+	if (extension == "pfm") {
+		return WritePFM(path, width, height, pixels);
+	}
+	if (extension == "png") {
+		return WritePNG(path, width, height, pixels);
+	}
+	cerr << "Unknown image format for " << path << " (expected .ppm, .pfm or .png)" << endl;
+	return false;
+}
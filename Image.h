@@ -0,0 +1,23 @@
+#pragma once
+
+#include "header.h"
+
+//Functions for saving a rendered image to disk
+//The pixels are given row by row starting from the top left, as stored in the framebuffer
+
+//Write an 8-bit binary PPM (P6) image, colours are clamped to [0,1]
+//returns false if the file could not be written
+bool WritePPM(const string &path, int width, int height, const vector<glm::vec3> &pixels);
+
+//Write a floating point PFM image, colours are stored unclamped
+//returns false if the file could not be written
+bool WritePFM(const string &path, int width, int height, const vector<glm::vec3> &pixels);
+
+//Write an 8-bit RGB PNG image, colours are clamped to [0,1]
+//The image data is stored uncompressed so no external library is needed
+//returns false if the file could not be written
+bool WritePNG(const string &path, int width, int height, const vector<glm::vec3> &pixels);
+
+//Write the image in the format given by the file extension (.ppm, .pfm or .png)
+//returns false if the extension is not recognised or the file could not be written
+bool WriteImage(const string &path, int width, int height, const vector<glm::vec3> &pixels);
@@ -0,0 +1,49 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile():
+	_data(NULL),
+	_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const string &path)
+{
+	Close();
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size <= 0) {
+		close(file);
+		return false;
+	}
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	// The mapping stays valid after the file is closed
+	close(file);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	_data = (char *)data;
+	_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data != NULL) {
+		munmap(_data, _size);
+		_data = NULL;
+		_size = 0;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "header.h"
+
+//A whole file mapped into memory, so it can be used in place without reading or copying it
+//Pages are only loaded from disk when they are first touched. The mapping is copy-on-write: the memory
+//can be changed, but the changes are private to this process and never written back to the file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//Map a file, replacing any file mapped before
+	//returns false if the file could not be opened or mapped, or is empty
+	bool Open(const string &path);
+
+	//The start of the file in memory, aligned to a page
+	char *Data() const { return _data; }
+
+	//Returns the size of the file in bytes
+	size_t Size() const { return _size; }
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator =(const MappedFile &);
+
+	void Close();
+
+	char *_data;
+	size_t _size;
+};
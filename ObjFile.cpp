@@ -0,0 +1,177 @@
+#include "ObjFile.h"
+#include "ParseNumber.h"
+
+#include <cstdio>
+
+//How much of the file is read at a time
+static const size_t kChunkSize = 1 << 20;
+
+//Turns the lines of an OBJ file into mesh vertices and faces
+class ObjFileParser
+{
+public:
+	ObjFileParser(const string &path, PrimitiveStore &primitives, int material,
+	              const unordered_map<string, int> &materials, const glm::mat4 &transform):
+		_path(path),
+		_primitives(primitives),
+		_defaultMaterial(material),
+		_material(material),
+		_materials(materials),
+		_transform(transform),
+		_firstVertex(primitives.MeshVertexCount()),
+		_line(0)
+	{
+	}
+
+	//Parse one line
+	//@text The line, ending with a null character instead of the line break
+	//returns false if there is an error, which has been printed
+	bool ParseLine(const char *text)
+	{
+		++_line;
+		const char *pos = text;
+		SkipSpace(pos);
+		if (pos[0] == 'v' && IsSpace(pos[1])) {
+			pos += 2;
+			glm::vec3 position;
+			for (int axis = 0; axis < 3; ++axis) {
+				SkipSpace(pos);
+				if (!ParseFloat(pos, position[axis])) {
+					return Error("expected a vertex position");
+				}
+			}
+			_primitives.AddMeshVertex(glm::vec3(_transform * glm::vec4(position, 1.0f)));
+		}
+		else if (pos[0] == 'f' && IsSpace(pos[1])) {
+			return ParseFace(pos + 2);
+		}
+		else if (strncmp(pos, "usemtl", 6) == 0 && IsSpace(pos[6])) {
+			pos += 6;
+			SkipSpace(pos);
+			const char *end = pos;
+			while (*end != '\0' && !IsSpace(*end)) {
+				++end;
+			}
+			unordered_map<string, int>::const_iterator found = _materials.find(string(pos, end));
+			_material = found != _materials.end() ? found->second : _defaultMaterial;
+		}
+		// Anything else (comments, texture coordinates, normals, groups, ...) is not needed
+		return true;
+	}
+
+private:
+	//Parse the vertices of a face, each one written as v, v/vt, v//vn or v/vt/vn, and add it as a fan of triangles
+	bool ParseFace(const char *pos)
+	{
+		_face.clear();
+		int numVertices = _primitives.MeshVertexCount() - _firstVertex;
+		for (;;) {
+			SkipSpace(pos);
+			if (*pos == '\0' || *pos == '#') {
+				break;
+			}
+			int index;
+			if (!ParseInt(pos, index)) {
+				return Error("expected a vertex index");
+			}
+			// Indices count from 1, negative ones count back from the last vertex read
+			if (index > 0 && index <= numVertices) {
+				_face.push_back(_firstVertex + index - 1);
+			}
+			else if (index < 0 && -index <= numVertices) {
+				_face.push_back(_firstVertex + numVertices + index);
+			}
+			else {
+				return Error("vertex index out of range");
+			}
+			// Skip the texture coordinate and normal indices
+			while (*pos != '\0' && !IsSpace(*pos)) {
+				++pos;
+			}
+		}
+		if (_face.size() < 3) {
+			return Error("a face needs at least three vertices");
+		}
+		for (size_t i = 1; i + 1 < _face.size(); ++i) {
+			_primitives.AddMeshTriangle(_face[0], _face[i], _face[i + 1], _material);
+		}
+		return true;
+	}
+
+	static bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	static void SkipSpace(const char *&pos)
+	{
+		while (IsSpace(*pos)) {
+			++pos;
+		}
+	}
+
+	//Print an error with the position in the file
+	//returns false so that it can be returned straight from a parse function
+	bool Error(const string &message) const
+	{
+		cerr << _path << ":" << _line << ": " << message << endl;
+		return false;
+	}
+
+	string _path;
+	PrimitiveStore &_primitives;
+	int _defaultMaterial;
+	int _material; // The material for the faces, set by usemtl
+	const unordered_map<string, int> &_materials;
+	glm::mat4 _transform;
+	int _firstVertex; // The index in the store of the first vertex of this file
+	int _line;
+	vector<int> _face; // The vertices of the face being read
+};
+
+bool LoadObjFile(const string &path, PrimitiveStore &primitives, int material,
+                 const unordered_map<string, int> &materials, const glm::mat4 &transform)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		cerr << "Could not open OBJ file " << path << endl;
+		return false;
+	}
+
+	// Read a chunk at a time and parse each complete line in it. A line cut off at the end of the chunk is moved
+	// to the start of the buffer to be finished by the next chunk. The extra byte leaves room to end the last line
+	ObjFileParser parser(path, primitives, material, materials, transform);
+	vector<char> buffer(kChunkSize + 1);
+	size_t carried = 0;
+	bool ok = true;
+	while (ok) {
+		if (carried == buffer.size() - 1) {
+			buffer.resize(2 * buffer.size()); // One line fills the whole buffer
+		}
+		size_t read = fread(&buffer[carried], 1, buffer.size() - 1 - carried, file);
+		char *line = &buffer[0];
+		char *end = line + carried + read;
+		char *lineEnd;
+		while (ok && (lineEnd = (char *)memchr(line, '\n', end - line)) != NULL) {
+			*lineEnd = '\0';
+			ok = parser.ParseLine(line);
+			line = lineEnd + 1;
+		}
+		if (read == 0) {
+			// The end of the file, which may finish without a line break
+			if (ok && line < end) {
+				*end = '\0';
+				ok = parser.ParseLine(line);
+			}
+			break;
+		}
+		carried = end - line;
+		memmove(&buffer[0], line, carried);
+	}
+	if (ok && ferror(file)) {
+		cerr << "Could not read OBJ file " << path << endl;
+		ok = false;
+	}
+	fclose(file);
+	return ok;
+}
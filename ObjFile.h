@@ -0,0 +1,19 @@
+#pragma once
+
+#include "PrimitiveStore.h"
+
+#include <unordered_map>
+
+//Import the triangles of a Wavefront OBJ file straight into primitive storage as a triangle mesh
+//The file is read a piece at a time and each vertex and face is added as soon as it is read, so however big the
+//file is the only memory used is the compact mesh itself. Faces with more than three vertices are split into a
+//fan of triangles. Only the vertex positions are used: texture coordinates, normals, groups and .mtl files are ignored
+//@path The file to read
+//@primitives The store to add the vertices and faces to
+//@material Index of the material for the faces before the first usemtl line, or after one that names a material
+//that is not in materials
+//@materials Materials that a usemtl line can select by name
+//@transform Applied to each vertex, e.g. to scale the model and place it in the scene
+//returns false if the file could not be read or has an error (which is printed)
+bool LoadObjFile(const string &path, PrimitiveStore &primitives, int material,
+                 const unordered_map<string, int> &materials, const glm::mat4 &transform = glm::mat4(1.0f));
@@ -1,4 +1,5 @@
 #include "Object.h"
+#include "PrimitiveStore.h"
 
 #include "header.h"
 
@@ -59,7 +60,7 @@ bool solveQuadraticEquation( const float &a, const float &b, const float &c, flo
     return true;
 }
 
-bool Sphere::Intersect(const Ray &ray, IntersectInfo &info) {
+bool Sphere::Hit(const Ray &ray, float &time) const {
 
     // A ray can intersect a sphere 0, 1 or 2 times
     float root0, root1;
@@ -85,15 +86,28 @@ bool Sphere::Intersect(const Ray &ray, IntersectInfo &info) {
     }
 
     // If we get here then a collison has occurred at t = root0
-    info.time = root0;
+    time = root0;
+    return true;
+}
+
+bool Sphere::Intersect(const Ray &ray, IntersectInfo &info) const {
+    float timeOfIntersect;
+    if (!Hit(ray, timeOfIntersect)) {
+        return false;
+    }
+    info.time = timeOfIntersect;
     info.material = this->MaterialPtr();
     info.hitPoint = glm::vec3(ray(info.time));
     info.normal = glm::normalize(info.hitPoint - centre);
     return true;
 }
 
+void Sphere::Compile(PrimitiveStore &store) const {
+    store.AddSphere(centre, radius, store.AddMaterial(_material));
+}
+
 
-bool Plane::Intersect(const Ray &ray, IntersectInfo &info) {
+bool Plane::Hit(const Ray &ray, float &time) const {
 
     // timeOfIntersect = (p0 - rayOrigin) . planeNormal
     //                      rayDirection . planeNormal
@@ -107,19 +121,33 @@ bool Plane::Intersect(const Ray &ray, IntersectInfo &info) {
         glm::vec3 rayDist = (p0 - ray.origin);
         float timeOfIntersect = glm::dot(rayDist, n) / denominator;
         if (timeOfIntersect > 0) {
-            info.time = timeOfIntersect;
-            info.material = this->MaterialPtr();
-            info.hitPoint = glm::vec3(ray(info.time));
-            info.normal = glm::normalize(n);
+            time = timeOfIntersect;
             return true;
         }
     }
+    // The plane is behind the ray
+    return false;
+}
 
+bool Plane::Intersect(const Ray &ray, IntersectInfo &info) const {
+    float timeOfIntersect;
+    if (!Hit(ray, timeOfIntersect)) {
+        return false;
+    }
+    info.time = timeOfIntersect;
+    info.material = this->MaterialPtr();
+    info.hitPoint = glm::vec3(ray(info.time));
+    info.normal = glm::normalize(n);
+    return true;
+}
+
+void Plane::Compile(PrimitiveStore &store) const {
+    store.AddPlane(p0, n, store.AddMaterial(_material));
 }
 
 // The theory for this method was adapted from the course slides and the 'scratchapixel' online tutorial
 // and the lecture slides
-bool Triangle::Intersect(const Ray &ray, IntersectInfo &info) {
+bool Triangle::Hit(const Ray &ray, float &time) const {
     // We need to decide if the ray intersects the plane that the triangle is on and then
     // if the intersection point is within the triangle boundaries
 
@@ -181,192 +209,81 @@ bool Triangle::Intersect(const Ray &ray, IntersectInfo &info) {
     }
 
     // If we get here then a collison has indeed occurred
+    time = timeOfIntersect;
+    return true;
+}
+
+bool Triangle::Intersect(const Ray &ray, IntersectInfo &info) const {
+    float timeOfIntersect;
+    if (!Hit(ray, timeOfIntersect)) {
+        return false;
+    }
     info.time = timeOfIntersect;
     info.material = this->MaterialPtr();
     info.hitPoint = glm::vec3(ray(info.time));
-    info.normal = glm::normalize(N);
+    info.normal = glm::normalize(normal);
     return true;
 }
 
-bool AxisAlignedBox::Intersect(const Ray &ray, IntersectInfo &info) {
-
-    // Get the data of the box
-    float minX = min(p1.x, p2.x);
-    float maxX = max(p1.x, p2.x);
-    float minY = min(p1.y, p2.y);
-    float maxY = max(p1.y, p2.y);
-    float minZ = min(p1.z, p2.z);
-    float maxZ = max(p1.z, p2.z);
-
-    // Definitions for variables needed
-    glm::vec3 N; // the normal of the face
-    glm::vec3 P; // the point of intersection
-    float denominator; // the ray direction . normal
-    glm::vec3 rayDist;
+void Triangle::Compile(PrimitiveStore &store) const {
+    store.AddTriangle(A, B, C, store.AddMaterial(_material));
+}
+
+bool AxisAlignedBox::Intersect(const Ray &ray, IntersectInfo &info) const {
+    // A slab test finds where the ray enters the box, or leaves it if the ray starts inside, without
+    // testing the six faces one by one
+    BoundingBox box(boxMin, boxMax);
     float timeOfIntersect;
+    if (!box.HitSurface(ray, timeOfIntersect)) {
+        return false;
+    }
+    info.time = timeOfIntersect;
+    info.material = this->MaterialPtr();
+    info.hitPoint = glm::vec3(ray(info.time));
+    info.normal = box.SurfaceNormal(ray, info.time);
+    return true;
+}
 
-    float delta = 1e-8;
+void AxisAlignedBox::Compile(PrimitiveStore &store) const {
+    store.AddBox(boxMin, boxMax, store.AddMaterial(_material));
+}
 
-    // 6 possible faces that could be collided with
-    // Front face
-    N = glm::vec3(0, 0, 1);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //
-    }
-    else {
-        rayDist = (glm::vec3((minX + maxX / 2.0f), (minY + maxY / 2.0f), maxZ) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x <= maxX && P.x >= minX &&
-                    P.y <= maxY && P.y >= minY &&
-                    P.z == maxZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
-        }
-    }
-    // Top face
-    N = glm::vec3(0, 1, 0);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //return false;
-    }
-    else {
-        rayDist = (glm::vec3((minX + maxX / 2.0f), maxY, (minZ + maxZ / 2.0f)) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x <= maxX && P.x >= minX &&
-                    P.y == maxY &&
-                    P.z <= maxZ && P.z >= minZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
-        }
-    }
+int TriangleMesh::AddVertex(const glm::vec3 &position) {
+    _vertices.push_back(position);
+    return (int)_vertices.size() - 1;
+}
 
-    // Left face
-    N = glm::vec3(-1, 0, 0);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //return false;
-    }
-    else {
-        rayDist = (glm::vec3(minX, (minY + maxY / 2.0f), (minZ + maxZ / 2.0f)) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x == minX &&
-                    P.y <= maxY && P.y >= minY &&
-                    P.z <= maxZ && P.z >= minZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
-        }
-    }
-    // Right face
-    N = glm::vec3(1, 0, 0);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //return false;
-    }
-    else {
-        rayDist = (glm::vec3(maxX, (minY + maxY / 2.0f), (minZ + maxZ / 2.0f)) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x == maxX &&
-                    P.y <= maxY && P.y >= minY &&
-                    P.z <= maxZ && P.z >= minZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
-        }
-    }
+void TriangleMesh::AddTriangle(int v0, int v1, int v2) {
+    _indices.push_back(v0);
+    _indices.push_back(v1);
+    _indices.push_back(v2);
+}
 
-    // Back face
-    N = glm::vec3(0, 0, -1);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //
-    }
-    else {
-        rayDist = (glm::vec3((minX + maxX / 2.0f), (minY + maxY / 2.0f), minZ) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x <= maxX && P.x >= minX &&
-                    P.y <= maxY && P.y >= minY &&
-                    P.z == minZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
-        }
+void TriangleMesh::SetMaterial(const Material &material) {
+    int triangle = (int)_indices.size() / 3;
+    // A range with no triangles in it yet is just replaced
+    if (!_rangeStart.empty() && _rangeStart.back() == triangle) {
+        _rangeMaterial.back() = material;
+        return;
     }
-    // Bottom face
-    N = glm::vec3(0, -1, 0);
-    denominator = glm::dot(ray.direction, N);
-    // Fails if hitting from the underside or parallel
-    if (abs(denominator) < delta) {
-        //return false;
+    _rangeStart.push_back(triangle);
+    _rangeMaterial.push_back(material);
+}
+
+void TriangleMesh::Compile(PrimitiveStore &store) const {
+    int firstVertex = store.MeshVertexCount();
+    for (size_t i = 0; i < _vertices.size(); ++i) {
+        store.AddMeshVertex(_vertices[i]);
     }
-    else {
-        rayDist = (glm::vec3((minX + maxX / 2.0f), minY, (minZ + maxZ / 2.0f)) - ray.origin);
-        timeOfIntersect = glm::dot(rayDist, N) / denominator;
-        if (timeOfIntersect > 0) {
-            P = ray(timeOfIntersect);
-            if (P.x <= maxX && P.x >= minX &&
-                    P.y == minY &&
-                    P.z <= maxZ && P.z >= minZ) {
-
-                if (timeOfIntersect < info.time) {
-                    info.time = timeOfIntersect;
-                    info.material = this->MaterialPtr();
-                    info.hitPoint = glm::vec3(ray(info.time));
-                    info.normal = glm::normalize(N);
-                }
-            }
+    int material = store.AddMaterial(_material);
+    size_t range = 0;
+    for (int triangle = 0; triangle < (int)_indices.size() / 3; ++triangle) {
+        while (range < _rangeStart.size() && _rangeStart[range] <= triangle) {
+            material = store.AddMaterial(_rangeMaterial[range++]);
         }
+        store.AddMeshTriangle(firstVertex + _indices[3 * triangle], firstVertex + _indices[3 * triangle + 1],
+                              firstVertex + _indices[3 * triangle + 2], material);
     }
-
-    if (info.time < std::numeric_limits<float>::infinity()) {
-        return true;
-    }
-    // If we get here then fail
-    return false;
-
 }
 
 float fmax(float f1, float f2, float f3) {
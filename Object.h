@@ -2,6 +2,8 @@
 
 #include "Ray.h"
 
+class PrimitiveStore;
+
 //Holds material information of a particular object
 class Material
 {
@@ -28,10 +30,18 @@ public:
 	//@material The material properties of the object
 	Object(const glm::mat4 &transform = glm::mat4(1.0f), const Material &material = Material());
 
+	//Virtual so that a scene can delete any kind of object through an Object pointer
+	virtual ~Object() {}
+
 	//Test whether a ray intersects the object
 	//@ray The ray that we are testing for intersection
 	//@info Object containing information on the intersection between the ray and the object(if any)
-	virtual bool Intersect(const Ray &ray, IntersectInfo &info)  { return true; }
+	virtual bool Intersect(const Ray &ray, IntersectInfo &info) const { return true; }
+
+	//Add the object to the compact storage that the renderer intersects rays with
+	//The default adds nothing, so an object without a compiled form is not rendered
+	//@store The store to add the object and its material to
+	virtual void Compile(PrimitiveStore & /*store*/) const {}
 
 	//Retrun the position of the object, according to its transformation matrix
 	glm::vec3 Position() const { return glm::vec3(_transform[3][0], _transform[3][1], _transform[3][2]); }
@@ -44,6 +54,12 @@ protected:
 	Material _material;
 };
 
+//Solve the quadratic equation ax^2 + bx + c = 0
+//@root0 Set to the smaller root
+//@root1 Set to the larger root
+//returns false if there are no real roots
+bool solveQuadraticEquation(const float &a, const float &b, const float &c, float &root0, float &root1);
+
 // A sphere object with radius and centre coordinate attributes
 class Sphere : public Object {
 public:
@@ -57,7 +73,12 @@ public:
 		centre = c;
 		_material = material;
 	}
-	bool Intersect(const Ray &ray, IntersectInfo &info);
+	bool Intersect(const Ray &ray, IntersectInfo &info) const;
+	void Compile(PrimitiveStore &store) const;
+
+private:
+	//Find the time along the ray of the nearest intersection in front of the origin (if any)
+	bool Hit(const Ray &ray, float &time) const;
 };
 
 // A plane defined by a point that lies on the plane and the normal vector
@@ -72,7 +93,12 @@ public:
 		n = glm::normalize(_n); // make sure that the normla is indeed normal
 		_material = material;
 	}
-	bool Intersect(const Ray &ray, IntersectInfo &info);
+	bool Intersect(const Ray &ray, IntersectInfo &info) const;
+	void Compile(PrimitiveStore &store) const;
+
+private:
+	//Find the time along the ray of the nearest intersection in front of the origin (if any)
+	bool Hit(const Ray &ray, float &time) const;
 };
 
 // A triangle can be defined as three points in 3D space
@@ -96,7 +122,12 @@ public:
 
 		_material = material;
 	}
-	bool Intersect(const Ray &ray, IntersectInfo &info);
+	bool Intersect(const Ray &ray, IntersectInfo &info) const;
+	void Compile(PrimitiveStore &store) const;
+
+private:
+	//Find the time along the ray of the nearest intersection in front of the origin (if any)
+	bool Hit(const Ray &ray, float &time) const;
 };
 
 // An axis-aligned box can be defined by two points in 3D space representing the corners
@@ -105,16 +136,54 @@ public:
 class AxisAlignedBox : public Object {
 public:
 
-	glm::vec3 p1; // one corner
-	glm::vec3 p2; // the opposite corner
+	glm::vec3 boxMin; // the minimum X,Y,Z corner
+	glm::vec3 boxMax; // the maximum X,Y,Z corner
 
+	//@_p1, _p2 Any two opposite corners
 	AxisAlignedBox(glm::vec3 _p1, glm::vec3 _p2, Material &material) : Object() {
-		p1 = _p1;
-		p2 = _p2;
+		boxMin = glm::min(_p1, _p2);
+		boxMax = glm::max(_p1, _p2);
+		_material = material;
+	}
+
+	bool Intersect(const Ray &ray, IntersectInfo &info) const;
+	void Compile(PrimitiveStore &store) const;
+};
+
+// A mesh of triangles that share their vertices, e.g. a model imported from an OBJ file (see ObjFile.h)
+// Each vertex is stored once and each triangle refers to three of them by index, which takes a fraction of
+// the memory of separate Triangle objects. Ranges of triangles can use different materials
+// When compiled, the triangles go into the scene's BVH one by one alongside everything else, so a ray
+// only tests the few triangles of the mesh that are near its path. A mesh is only ever traced in its compiled
+// form, so its Intersect never reports a hit
+class TriangleMesh : public Object {
+public:
+
+	TriangleMesh(Material &material) : Object() {
 		_material = material;
 	}
 
-	bool Intersect(const Ray &ray, IntersectInfo &info);
+	//Add a vertex
+	//returns the index of the vertex, to pass to AddTriangle
+	int AddVertex(const glm::vec3 &position);
+
+	//Add a triangle that uses the current material
+	//@v0, v1, v2 The indices of the triangle's vertices
+	void AddTriangle(int v0, int v1, int v2);
+
+	//Use a different material for the triangles added from now on
+	void SetMaterial(const Material &material);
+
+	//A mesh that has not been compiled is never hit
+	bool Intersect(const Ray & /*ray*/, IntersectInfo & /*info*/) const { return false; }
+	void Compile(PrimitiveStore &store) const;
+
+private:
+	vector<glm::vec3> _vertices;
+	vector<int> _indices; // Three vertex indices per triangle
+	// The triangles from _rangeStart[i] on use _rangeMaterial[i], the triangles before the first range use _material
+	vector<int> _rangeStart;
+	vector<Material> _rangeMaterial;
 };
 
 
@@ -0,0 +1,104 @@
+#include "ParseNumber.h"
+
+#include <cstdlib>
+#include <climits>
+
+//Exact powers of ten, as far as a double can hold them exactly
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool ParseFloat(const char *&pos, float &value)
+{
+	const char *p = pos;
+	bool negative = false;
+	if (*p == '-' || *p == '+') {
+		negative = (*p == '-');
+		++p;
+	}
+
+	// Collect up to 19 significant digits as an integer, remembering where the decimal point goes
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+	for (; *p >= '0' && *p <= '9'; ++p) {
+		anyDigits = true;
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += (mantissa != 0);
+		}
+		else {
+			++exponent;
+		}
+	}
+	if (*p == '.') {
+		for (++p; *p >= '0' && *p <= '9'; ++p) {
+			anyDigits = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += (mantissa != 0);
+				--exponent;
+			}
+		}
+	}
+	if (!anyDigits) {
+		return false;
+	}
+	if (*p == 'e' || *p == 'E') {
+		++p;
+		bool negativeExponent = false;
+		if (*p == '-' || *p == '+') {
+			negativeExponent = (*p == '-');
+			++p;
+		}
+		if (*p < '0' || *p > '9') {
+			return false;
+		}
+		int written = 0;
+		for (; *p >= '0' && *p <= '9'; ++p) {
+			written = glm::min(written * 10 + (*p - '0'), 100000);
+		}
+		exponent += negativeExponent ? -written : written;
+	}
+
+	// Scaling by an exact power of ten gives a correctly rounded double whenever the mantissa fits in one.
+	// Anything else is rare enough to leave to strtod
+	double result;
+	if (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22) {
+		result = exponent < 0 ? mantissa / powersOfTen[-exponent] : mantissa * powersOfTen[exponent];
+		if (negative) {
+			result = -result;
+		}
+	}
+	else {
+		result = strtod(string(pos, p).c_str(), NULL);
+	}
+	value = (float)result;
+	pos = p;
+	return true;
+}
+
+bool ParseInt(const char *&pos, int &value)
+{
+	const char *p = pos;
+	bool negative = false;
+	if (*p == '-' || *p == '+') {
+		negative = (*p == '-');
+		++p;
+	}
+	if (*p < '0' || *p > '9') {
+		return false;
+	}
+	long long result = 0;
+	for (; *p >= '0' && *p <= '9'; ++p) {
+		result = result * 10 + (*p - '0');
+		if (result > INT_MAX) {
+			return false;
+		}
+	}
+	value = (int)(negative ? -result : result);
+	pos = p;
+	return true;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "header.h"
+
+//Fast parsing of numbers in text files such as scene and OBJ files, which can hold millions of them
+//Streams and strtod are far too slow for that, so these are written by hand for plain decimal numbers
+
+//Read a decimal number such as -12, 0.5 or 1.5e-3
+//@pos The start of the number, moved to the first character after it if one is read
+//@value Set to the number
+//returns false if there is not a number at pos
+bool ParseFloat(const char *&pos, float &value);
+
+//Read a whole number such as 12 or -3
+//@pos The start of the number, moved to the first character after it if one is read
+//@value Set to the number
+//returns false if there is not a number at pos or it is too big for an int
+bool ParseInt(const char *&pos, int &value);
@@ -0,0 +1,744 @@
+#include "PrimitiveStore.h"
+#include "RenderStats.h"
+
+//Runs of fewer triangles than this are tested one at a time, as filling the lanes costs more than it saves
+static const int kMinTriangleBatch = 2;
+
+//Returns true if two materials would shade identically
+static bool SameMaterial(const Material &a, const Material &b)
+{
+	return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular &&
+	       a.specularExponent == b.specularExponent && a.Klocal == b.Klocal && a.Kreflectivity == b.Kreflectivity;
+}
+
+int PrimitiveStore::AddMaterial(const Material &material)
+{
+	for (size_t i = 0; i < _materials.size(); ++i) {
+		if (SameMaterial(_materials[i], material)) {
+			return (int)i;
+		}
+	}
+	_materials.push_back(material);
+	return (int)_materials.size() - 1;
+}
+
+int PrimitiveStore::AddSphere(const glm::vec3 &centre, float radius, int material)
+{
+	_spheres.centreX.push_back(centre.x);
+	_spheres.centreY.push_back(centre.y);
+	_spheres.centreZ.push_back(centre.z);
+	_spheres.radius.push_back(radius);
+	_spheres.radius2.push_back(radius * radius);
+	_spheres.material.push_back(material);
+	return (int)_spheres.material.size() - 1;
+}
+
+int PrimitiveStore::AddPlane(const glm::vec3 &point, const glm::vec3 &normal, int material)
+{
+	glm::vec3 n = glm::normalize(normal);
+	_planes.pointX.push_back(point.x);
+	_planes.pointY.push_back(point.y);
+	_planes.pointZ.push_back(point.z);
+	_planes.normalX.push_back(n.x);
+	_planes.normalY.push_back(n.y);
+	_planes.normalZ.push_back(n.z);
+	_planes.material.push_back(material);
+	return (int)_planes.material.size() - 1;
+}
+
+int PrimitiveStore::AddTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, int material)
+{
+	glm::vec3 u = b - a;
+	glm::vec3 v = c - a;
+	// Triangles are double-sided so it doesn't matter which way the normal points
+	glm::vec3 n = glm::normalize(glm::cross(u, v));
+
+	_triangles.aX.push_back(a.x);
+	_triangles.aY.push_back(a.y);
+	_triangles.aZ.push_back(a.z);
+	_triangles.uX.push_back(u.x);
+	_triangles.uY.push_back(u.y);
+	_triangles.uZ.push_back(u.z);
+	_triangles.vX.push_back(v.x);
+	_triangles.vY.push_back(v.y);
+	_triangles.vZ.push_back(v.z);
+	_triangles.normalX.push_back(n.x);
+	_triangles.normalY.push_back(n.y);
+	_triangles.normalZ.push_back(n.z);
+	_triangles.material.push_back(material);
+	return (int)_triangles.material.size() - 1;
+}
+
+int PrimitiveStore::AddBox(const glm::vec3 &corner1, const glm::vec3 &corner2, int material)
+{
+	glm::vec3 boxMin = glm::min(corner1, corner2);
+	glm::vec3 boxMax = glm::max(corner1, corner2);
+	_boxes.minX.push_back(boxMin.x);
+	_boxes.minY.push_back(boxMin.y);
+	_boxes.minZ.push_back(boxMin.z);
+	_boxes.maxX.push_back(boxMax.x);
+	_boxes.maxY.push_back(boxMax.y);
+	_boxes.maxZ.push_back(boxMax.z);
+	_boxes.material.push_back(material);
+	return (int)_boxes.material.size() - 1;
+}
+
+int PrimitiveStore::AddMeshVertex(const glm::vec3 &position)
+{
+	_meshVertices.x.push_back(position.x);
+	_meshVertices.y.push_back(position.y);
+	_meshVertices.z.push_back(position.z);
+	return (int)_meshVertices.x.size() - 1;
+}
+
+int PrimitiveStore::AddMeshTriangle(int v0, int v1, int v2, int material)
+{
+	_meshTriangles.vertex0.push_back(v0);
+	_meshTriangles.vertex1.push_back(v1);
+	_meshTriangles.vertex2.push_back(v2);
+	_meshTriangles.material.push_back(material);
+	return (int)_meshTriangles.material.size() - 1;
+}
+
+int PrimitiveStore::Count(int kind) const
+{
+	switch (kind) {
+	case kSphere :
+		return (int)_spheres.material.size();
+	case kTriangle :
+		return (int)_triangles.material.size();
+	case kBox :
+		return (int)_boxes.material.size();
+	case kMeshTriangle :
+		return (int)_meshTriangles.material.size();
+	case kPlane :
+		return (int)_planes.material.size();
+	default :
+		return 0;
+	}
+}
+
+//Checks that every array it is called on has the same number of elements
+struct SameLength
+{
+	size_t length;
+	bool ok;
+
+	template<class T> void operator()(const Array<T> &values)
+	{
+		ok = ok && values.size() == length;
+	}
+};
+
+//Returns true if each array of a kind has one element per primitive
+template<class T> static bool ArraysMatch(const T &arrays)
+{
+	SameLength check = { arrays.material.size(), true };
+	const_cast<T &>(arrays).ForEachArray(check); // The check only reads the arrays
+	return check.ok;
+}
+
+//Returns true if every index is at least 0 and less than count
+static bool IndicesInRange(const Array<int> &indices, int count)
+{
+	for (size_t i = 0; i < indices.size(); ++i) {
+		if (indices[i] < 0 || indices[i] >= count) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool PrimitiveStore::Validate() const
+{
+	int numMaterials = (int)_materials.size();
+	int numVertices = (int)_meshVertices.x.size();
+	return ArraysMatch(_spheres) && ArraysMatch(_triangles) && ArraysMatch(_boxes) &&
+	       ArraysMatch(_meshTriangles) && ArraysMatch(_planes) &&
+	       _meshVertices.y.size() == _meshVertices.x.size() && _meshVertices.z.size() == _meshVertices.x.size() &&
+	       IndicesInRange(_spheres.material, numMaterials) && IndicesInRange(_triangles.material, numMaterials) &&
+	       IndicesInRange(_boxes.material, numMaterials) && IndicesInRange(_meshTriangles.material, numMaterials) &&
+	       IndicesInRange(_planes.material, numMaterials) && IndicesInRange(_meshTriangles.vertex0, numVertices) &&
+	       IndicesInRange(_meshTriangles.vertex1, numVertices) && IndicesInRange(_meshTriangles.vertex2, numVertices);
+}
+
+int PrimitiveStore::Size() const
+{
+	int size = 0;
+	for (int kind = 0; kind < kNumPrimitiveKinds; ++kind) {
+		size += Count(kind);
+	}
+	return size;
+}
+
+BoundingBox PrimitiveStore::Bounds(const PrimitiveRef &primitive) const
+{
+	int i = primitive.index;
+	switch (primitive.kind) {
+	case kSphere : {
+		glm::vec3 centre(_spheres.centreX[i], _spheres.centreY[i], _spheres.centreZ[i]);
+		glm::vec3 radius(_spheres.radius[i]);
+		return BoundingBox(centre - radius, centre + radius);
+	}
+	case kTriangle : {
+		glm::vec3 a(_triangles.aX[i], _triangles.aY[i], _triangles.aZ[i]);
+		BoundingBox box;
+		box.Grow(a);
+		box.Grow(a + glm::vec3(_triangles.uX[i], _triangles.uY[i], _triangles.uZ[i]));
+		box.Grow(a + glm::vec3(_triangles.vX[i], _triangles.vY[i], _triangles.vZ[i]));
+		return box;
+	}
+	case kBox :
+		return Box(i);
+	case kMeshTriangle : {
+		BoundingBox box;
+		box.Grow(MeshVertex(_meshTriangles.vertex0[i]));
+		box.Grow(MeshVertex(_meshTriangles.vertex1[i]));
+		box.Grow(MeshVertex(_meshTriangles.vertex2[i]));
+		return box;
+	}
+	default :
+		return BoundingBox(); // planes have no bounds
+	}
+}
+
+//Applies a permutation to each array of one kind of primitive
+struct Permuter
+{
+	const vector<int> &order;
+
+	template<class T> void operator()(Array<T> &values) const
+	{
+		vector<T> reordered(order.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			reordered[i] = values[order[i]];
+		}
+		values.Assign(reordered);
+	}
+};
+
+void PrimitiveStore::Reorder(int kind, const vector<int> &order)
+{
+	Permuter permute = { order };
+	switch (kind) {
+	case kSphere :
+		_spheres.ForEachArray(permute);
+		break;
+	case kTriangle :
+		_triangles.ForEachArray(permute);
+		break;
+	case kBox :
+		_boxes.ForEachArray(permute);
+		break;
+	case kMeshTriangle :
+		_meshTriangles.ForEachArray(permute);
+		break;
+	case kPlane :
+		_planes.ForEachArray(permute);
+		break;
+	}
+}
+
+bool PrimitiveStore::HitSphere(const Ray &ray, int i, float &time) const
+{
+	// A ray can intersect a sphere 0, 1 or 2 times
+	float root0, root1;
+
+	// Vector of where the centre of the sphere from the origin of the ray
+	glm::vec3 sphereOffset = ray.origin - glm::vec3(_spheres.centreX[i], _spheres.centreY[i], _spheres.centreZ[i]);
+
+	// Compute the quadratic coefficients
+	float a = glm::dot(ray.direction, ray.direction);
+	float b = 2.0f * glm::dot(ray.direction, sphereOffset);
+	float c = glm::dot(sphereOffset, sphereOffset) - _spheres.radius2[i];
+
+	// Solve the quadratic equation at^2 + bt + c = 0
+	if (!solveQuadraticEquation(a, b, c, root0, root1)) {
+		return false;
+	}
+	if (root0 < 0) {
+		root0 = root1; // If root 0 is negative then try root 1
+		if (root0 < 0) {
+			return false; // Both roots are negative so the sphere is behind the ray
+		}
+	}
+	time = root0;
+	return true;
+}
+
+bool PrimitiveStore::HitPlane(const Ray &ray, int i, float &time) const
+{
+	// timeOfIntersect = (p0 - rayOrigin) . planeNormal
+	//                      rayDirection . planeNormal
+	glm::vec3 n(_planes.normalX[i], _planes.normalY[i], _planes.normalZ[i]);
+	float denominator = glm::dot(ray.direction, n);
+	if (abs(denominator) < 1e-6) {
+		return false; // The ray is almost parallel to the surface
+	}
+	glm::vec3 rayDist = glm::vec3(_planes.pointX[i], _planes.pointY[i], _planes.pointZ[i]) - ray.origin;
+	float timeOfIntersect = glm::dot(rayDist, n) / denominator;
+	if (timeOfIntersect > 0) {
+		time = timeOfIntersect;
+		return true;
+	}
+	return false; // The plane is behind the ray
+}
+
+// Moller-Trumbore: solve for the distance along the ray and the barycentric coordinates of the hit in one go,
+// using only the two edges from the first vertex. The test is not watertight: rounding can let a ray through the
+// edge shared by two triangles miss both of them
+//@a The first vertex
+//@edge1 The edge from the first vertex to the second
+//@edge2 The edge from the first vertex to the third
+//@barycentric Set to the weights of the second and third vertices at the hit
+static bool IntersectTriangle(const Ray &ray, const glm::vec3 &a, const glm::vec3 &edge1, const glm::vec3 &edge2,
+                              float &time, glm::vec2 &barycentric)
+{
+	glm::vec3 p = glm::cross(ray.direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (determinant == 0.0f) {
+		return false; // The ray is parallel to the triangle
+	}
+	float inverse = 1.0f / determinant;
+	glm::vec3 offset = ray.origin - a;
+	float u = glm::dot(offset, p) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+	glm::vec3 q = glm::cross(offset, edge1);
+	float v = glm::dot(ray.direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+	float timeOfIntersect = glm::dot(edge2, q) * inverse;
+	if (timeOfIntersect < 0.0f) {
+		return false;
+	}
+	time = timeOfIntersect;
+	barycentric = glm::vec2(u, v);
+	return true;
+}
+
+// The same as IntersectTriangle for a triangle and a ray per lane. It does the same operations in the same
+// order, so each lane gives exactly the same result as the scalar version
+//@time Set to the time of the hit in the lanes that hit
+//@barycentric Set to the weights of the second and third vertices in the lanes that hit
+//returns the lanes where the ray hits the triangle
+static SimdMask IntersectTriangles(const SimdFloat origin[3], const SimdFloat direction[3], const SimdFloat a[3],
+                                   const SimdFloat edge1[3], const SimdFloat edge2[3], SimdFloat &time,
+                                   SimdFloat barycentric[2])
+{
+	SimdFloat p[3];
+	Cross(direction, edge2, p);
+	SimdFloat determinant = Dot(edge1, p);
+	SimdFloat inverse = SimdFloat(1.0f) / determinant;
+	SimdFloat offset[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+	SimdFloat u = Dot(offset, p) * inverse;
+	SimdFloat q[3];
+	Cross(offset, edge1, q);
+	SimdFloat v = Dot(direction, q) * inverse;
+	time = Dot(edge2, q) * inverse;
+	barycentric[0] = u;
+	barycentric[1] = v;
+
+	SimdMask miss = (determinant == SimdFloat(0.0f)) |
+	                (u < SimdFloat(0.0f)) | (u > SimdFloat(1.0f)) |
+	                (v < SimdFloat(0.0f)) | ((u + v) > SimdFloat(1.0f)) |
+	                (time < SimdFloat(0.0f));
+	return AndNot(SimdMask(true), miss);
+}
+
+bool PrimitiveStore::HitTriangle(const Ray &ray, int i, float &time, glm::vec2 &barycentric) const
+{
+	glm::vec3 a(_triangles.aX[i], _triangles.aY[i], _triangles.aZ[i]);
+	glm::vec3 edge1(_triangles.uX[i], _triangles.uY[i], _triangles.uZ[i]);
+	glm::vec3 edge2(_triangles.vX[i], _triangles.vY[i], _triangles.vZ[i]);
+	return IntersectTriangle(ray, a, edge1, edge2, time, barycentric);
+}
+
+// The triangles of a leaf are next to each other in the arrays, so a whole run of them loads straight into
+// the lanes and one ray is tested against all of them at once
+SimdMask PrimitiveStore::HitTriangleBatch(const Ray &ray, int i, int count, SimdFloat &time, SimdFloat barycentric[2]) const
+{
+	SimdFloat origin[3] = { SimdFloat(ray.origin.x), SimdFloat(ray.origin.y), SimdFloat(ray.origin.z) };
+	SimdFloat direction[3] = { SimdFloat(ray.direction.x), SimdFloat(ray.direction.y), SimdFloat(ray.direction.z) };
+	// The unused lanes are all zero, a triangle with no area that is never hit
+	SimdFloat a[3] = {
+		LoadPartial(&_triangles.aX[i], count), LoadPartial(&_triangles.aY[i], count), LoadPartial(&_triangles.aZ[i], count)
+	};
+	SimdFloat edge1[3] = {
+		LoadPartial(&_triangles.uX[i], count), LoadPartial(&_triangles.uY[i], count), LoadPartial(&_triangles.uZ[i], count)
+	};
+	SimdFloat edge2[3] = {
+		LoadPartial(&_triangles.vX[i], count), LoadPartial(&_triangles.vY[i], count), LoadPartial(&_triangles.vZ[i], count)
+	};
+	return IntersectTriangles(origin, direction, a, edge1, edge2, time, barycentric);
+}
+
+// The same slab test that the BVH uses for its nodes. Which face is hit is only needed for shading, so it is
+// left to IntersectInfoFor
+bool PrimitiveStore::HitBox(const Ray &ray, int i, float &time) const
+{
+	return Box(i).HitSurface(ray, time);
+}
+
+// Mesh faces only store vertex indices, so the edges are worked out from the shared vertices on every test
+bool PrimitiveStore::HitMeshTriangle(const Ray &ray, int i, float &time, glm::vec2 &barycentric) const
+{
+	glm::vec3 a = MeshVertex(_meshTriangles.vertex0[i]);
+	glm::vec3 edge1 = MeshVertex(_meshTriangles.vertex1[i]) - a;
+	glm::vec3 edge2 = MeshVertex(_meshTriangles.vertex2[i]) - a;
+	return IntersectTriangle(ray, a, edge1, edge2, time, barycentric);
+}
+
+bool PrimitiveStore::Intersect(int kind, const Ray &ray, int first, int count, PrimitiveHit &hit) const
+{
+	RT_STAT_ADD(kSphereTests + kind, count);
+	// One loop per kind so that the loop body is just the intersection test
+	int closest = -1;
+	float time;
+	glm::vec2 barycentric;
+	switch (kind) {
+	case kSphere :
+		for (int i = first; i < first + count; ++i) {
+			if (HitSphere(ray, i, time) && time < hit.time) {
+				hit.time = time;
+				closest = i;
+			}
+		}
+		break;
+	case kTriangle :
+		if (count < kMinTriangleBatch) {
+			for (int i = first; i < first + count; ++i) {
+				if (HitTriangle(ray, i, time, barycentric) && time < hit.time) {
+					hit.time = time;
+					hit.barycentric = barycentric;
+					closest = i;
+				}
+			}
+			break;
+		}
+		// Up to kSimdWidth triangles at a time. The lanes are then taken in order, so the closest hit (and the
+		// first of several at the same time) is the same as testing the triangles one after another
+		for (int i = first; i < first + count; i += kSimdWidth) {
+			SimdFloat times, barycentrics[2];
+			int bits = HitTriangleBatch(ray, i, glm::min(first + count - i, kSimdWidth), times, barycentrics).Bits();
+			if (bits == 0) {
+				continue;
+			}
+			float laneTimes[kSimdWidth], laneU[kSimdWidth], laneV[kSimdWidth];
+			times.Store(laneTimes);
+			barycentrics[0].Store(laneU);
+			barycentrics[1].Store(laneV);
+			for (int lane = 0; lane < kSimdWidth; ++lane) {
+				if ((bits & (1 << lane)) && laneTimes[lane] < hit.time) {
+					hit.time = laneTimes[lane];
+					hit.barycentric = glm::vec2(laneU[lane], laneV[lane]);
+					closest = i + lane;
+				}
+			}
+		}
+		break;
+	case kBox :
+		for (int i = first; i < first + count; ++i) {
+			if (HitBox(ray, i, time) && time < hit.time) {
+				hit.time = time;
+				closest = i;
+			}
+		}
+		break;
+	case kMeshTriangle :
+		for (int i = first; i < first + count; ++i) {
+			if (HitMeshTriangle(ray, i, time, barycentric) && time < hit.time) {
+				hit.time = time;
+				hit.barycentric = barycentric;
+				closest = i;
+			}
+		}
+		break;
+	case kPlane :
+		for (int i = first; i < first + count; ++i) {
+			if (HitPlane(ray, i, time) && time < hit.time) {
+				hit.time = time;
+				closest = i;
+			}
+		}
+		break;
+	}
+	if (closest < 0) {
+		return false;
+	}
+	hit.primitive.kind = kind;
+	hit.primitive.index = closest;
+	return true;
+}
+
+bool PrimitiveStore::Occluded(int kind, const Ray &ray, int first, int count, float tMax) const
+{
+	RT_STAT_ADD(kSphereTests + kind, count);
+	float time;
+	glm::vec2 barycentric;
+	switch (kind) {
+	case kSphere :
+		for (int i = first; i < first + count; ++i) {
+			if (HitSphere(ray, i, time) && time < tMax) {
+				return true;
+			}
+		}
+		break;
+	case kTriangle :
+		if (count < kMinTriangleBatch) {
+			for (int i = first; i < first + count; ++i) {
+				if (HitTriangle(ray, i, time, barycentric) && time < tMax) {
+					return true;
+				}
+			}
+			break;
+		}
+		for (int i = first; i < first + count; i += kSimdWidth) {
+			SimdFloat times, barycentrics[2];
+			SimdMask hit = HitTriangleBatch(ray, i, glm::min(first + count - i, kSimdWidth), times, barycentrics);
+			if ((hit & (times < SimdFloat(tMax))).Bits() != 0) {
+				return true;
+			}
+		}
+		break;
+	case kBox :
+		// The box is solid, so a ray is blocked if it passes through the box anywhere before tMax, whether
+		// or not it hits the surface
+		for (int i = first; i < first + count; ++i) {
+			if (Box(i).Intersect(ray, tMax, time)) {
+				return true;
+			}
+		}
+		break;
+	case kMeshTriangle :
+		for (int i = first; i < first + count; ++i) {
+			if (HitMeshTriangle(ray, i, time, barycentric) && time < tMax) {
+				return true;
+			}
+		}
+		break;
+	case kPlane :
+		for (int i = first; i < first + count; ++i) {
+			if (HitPlane(ray, i, time) && time < tMax) {
+				return true;
+			}
+		}
+		break;
+	}
+	return false;
+}
+
+// The same as HitSphere but for every ray in the packet at once
+SimdMask PrimitiveStore::HitSpheres(const RayPacket &packet, int i, SimdFloat &time) const
+{
+	SimdFloat sphereOffset[3] = {
+		packet.origin[0] - SimdFloat(_spheres.centreX[i]),
+		packet.origin[1] - SimdFloat(_spheres.centreY[i]),
+		packet.origin[2] - SimdFloat(_spheres.centreZ[i])
+	};
+
+	// Compute the quadratic coefficients
+	SimdFloat a = Dot(packet.direction, packet.direction);
+	SimdFloat b = SimdFloat(2.0f) * Dot(packet.direction, sphereOffset);
+	SimdFloat c = Dot(sphereOffset, sphereOffset) - SimdFloat(_spheres.radius2[i]);
+
+	// Solve the quadratic equation at^2 + bt + c = 0, lanes with a negative discriminant miss
+	SimdFloat discriminant = b * b - SimdFloat(4.0f) * a * c;
+	SimdMask real = discriminant >= SimdFloat(0.0f);
+	SimdFloat root = Sqrt(Max(discriminant, SimdFloat(0.0f)));
+	SimdFloat q = Select(b > SimdFloat(0.0f), SimdFloat(-0.5f) * (b + root), SimdFloat(-0.5f) * (b - root));
+	SimdFloat root0 = q / a;
+	SimdFloat root1 = Select(discriminant == SimdFloat(0.0f), root0, c / q);
+
+	// Take the smallest root that is not behind the ray
+	SimdFloat nearRoot = Min(root0, root1);
+	SimdFloat farRoot = Max(root0, root1);
+	SimdFloat t = Select(nearRoot < SimdFloat(0.0f), farRoot, nearRoot);
+
+	SimdMask hit = real & (t >= SimdFloat(0.0f)) & (t < time);
+	time = Select(hit, t, time);
+	return hit;
+}
+
+// The same as HitPlane but for every ray in the packet at once
+SimdMask PrimitiveStore::HitPlanes(const RayPacket &packet, int i, SimdFloat &time) const
+{
+	glm::vec3 n(_planes.normalX[i], _planes.normalY[i], _planes.normalZ[i]);
+	SimdFloat denominator = Dot(packet.direction, n);
+	SimdFloat rayDist[3] = {
+		SimdFloat(_planes.pointX[i]) - packet.origin[0],
+		SimdFloat(_planes.pointY[i]) - packet.origin[1],
+		SimdFloat(_planes.pointZ[i]) - packet.origin[2]
+	};
+	SimdFloat t = Dot(rayDist, n) / denominator;
+
+	// Rays that are almost parallel to the surface miss
+	SimdMask hit = (Abs(denominator) >= SimdFloat(1e-6f)) & (t > SimdFloat(0.0f)) & (t < time);
+	time = Select(hit, t, time);
+	return hit;
+}
+
+// The same as HitTriangle but for every ray in the packet at once
+SimdMask PrimitiveStore::HitTriangles(const RayPacket &packet, int i, SimdFloat &time, SimdFloat barycentric[2]) const
+{
+	SimdFloat a[3] = { SimdFloat(_triangles.aX[i]), SimdFloat(_triangles.aY[i]), SimdFloat(_triangles.aZ[i]) };
+	SimdFloat edge1[3] = { SimdFloat(_triangles.uX[i]), SimdFloat(_triangles.uY[i]), SimdFloat(_triangles.uZ[i]) };
+	SimdFloat edge2[3] = { SimdFloat(_triangles.vX[i]), SimdFloat(_triangles.vY[i]), SimdFloat(_triangles.vZ[i]) };
+	SimdFloat t;
+	SimdMask hit = IntersectTriangles(packet.origin, packet.direction, a, edge1, edge2, t, barycentric);
+	hit = hit & (t < time);
+	time = Select(hit, t, time);
+	return hit;
+}
+
+// The same as HitMeshTriangle but for every ray in the packet at once
+SimdMask PrimitiveStore::HitMeshTriangles(const RayPacket &packet, int i, SimdFloat &time, SimdFloat barycentric[2]) const
+{
+	glm::vec3 vertex0 = MeshVertex(_meshTriangles.vertex0[i]);
+	glm::vec3 vertex1 = MeshVertex(_meshTriangles.vertex1[i]);
+	glm::vec3 vertex2 = MeshVertex(_meshTriangles.vertex2[i]);
+	SimdFloat a[3], edge1[3], edge2[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		a[axis] = SimdFloat(vertex0[axis]);
+		edge1[axis] = SimdFloat(vertex1[axis] - vertex0[axis]);
+		edge2[axis] = SimdFloat(vertex2[axis] - vertex0[axis]);
+	}
+	SimdFloat t;
+	SimdMask hit = IntersectTriangles(packet.origin, packet.direction, a, edge1, edge2, t, barycentric);
+	hit = hit & (t < time);
+	time = Select(hit, t, time);
+	return hit;
+}
+
+// The same as HitBox but for every ray in the packet at once
+SimdMask PrimitiveStore::HitBoxes(const RayPacket &packet, int i, SimdFloat &time) const
+{
+	SimdFloat t;
+	SimdMask hit = Box(i).HitSurface(packet, t);
+	hit = hit & (t < time);
+	time = Select(hit, t, time);
+	return hit;
+}
+
+SimdMask PrimitiveStore::IntersectPacket(int kind, const RayPacket &packet, int first, int count, SimdFloat &time, PrimitiveHit hits[]) const
+{
+	RT_STAT_ADD(kSphereTests + kind, count * kSimdWidth);
+	SimdMask found(false);
+	bool triangles = kind == kTriangle || kind == kMeshTriangle;
+	SimdFloat barycentric[2];
+	for (int i = first; i < first + count; ++i) {
+		SimdMask closer;
+		switch (kind) {
+		case kSphere :
+			closer = HitSpheres(packet, i, time);
+			break;
+		case kTriangle :
+			closer = HitTriangles(packet, i, time, barycentric);
+			break;
+		case kBox :
+			closer = HitBoxes(packet, i, time);
+			break;
+		case kMeshTriangle :
+			closer = HitMeshTriangles(packet, i, time, barycentric);
+			break;
+		default :
+			closer = HitPlanes(packet, i, time);
+			break;
+		}
+		int bits = closer.Bits();
+		if (bits == 0) {
+			continue;
+		}
+		float laneTimes[kSimdWidth], laneU[kSimdWidth], laneV[kSimdWidth];
+		time.Store(laneTimes);
+		if (triangles) {
+			barycentric[0].Store(laneU);
+			barycentric[1].Store(laneV);
+		}
+		for (int lane = 0; lane < kSimdWidth; ++lane) {
+			if (bits & (1 << lane)) {
+				hits[lane].time = laneTimes[lane];
+				hits[lane].primitive.kind = kind;
+				hits[lane].primitive.index = i;
+				if (triangles) {
+					hits[lane].barycentric = glm::vec2(laneU[lane], laneV[lane]);
+				}
+			}
+		}
+		found = found | closer;
+	}
+	return found;
+}
+
+SimdMask PrimitiveStore::OccludedPacket(int kind, const RayPacket &packet, int first, int count, const SimdFloat &tMax) const
+{
+	RT_STAT_ADD(kSphereTests + kind, count * kSimdWidth);
+	// A hit anywhere before tMax blocks the ray
+	SimdMask blocked(false);
+	SimdMask active = tMax > SimdFloat(0.0f);
+	SimdFloat barycentric[2];
+	for (int i = first; i < first + count; ++i) {
+		SimdFloat time = tMax;
+		switch (kind) {
+		case kBox :
+			// As in Occluded, passing through a solid box anywhere blocks the ray
+			blocked = blocked | (Box(i).Intersect(packet, tMax, time) & active);
+			break;
+		case kSphere :
+			blocked = blocked | HitSpheres(packet, i, time);
+			break;
+		case kTriangle :
+			blocked = blocked | HitTriangles(packet, i, time, barycentric);
+			break;
+		case kMeshTriangle :
+			blocked = blocked | HitMeshTriangles(packet, i, time, barycentric);
+			break;
+		default :
+			blocked = blocked | HitPlanes(packet, i, time);
+			break;
+		}
+	}
+	return blocked;
+}
+
+void PrimitiveStore::IntersectInfoFor(const Ray &ray, const PrimitiveHit &hit, IntersectInfo &info) const
+{
+	int i = hit.primitive.index;
+	glm::vec3 point = ray(hit.time);
+	glm::vec3 normal;
+	glm::vec2 barycentric(0.0f);
+	int material;
+	switch (hit.primitive.kind) {
+	case kSphere :
+		normal = glm::normalize(point - glm::vec3(_spheres.centreX[i], _spheres.centreY[i], _spheres.centreZ[i]));
+		material = _spheres.material[i];
+		break;
+	case kTriangle :
+		barycentric = hit.barycentric;
+		normal = glm::normalize(glm::vec3(_triangles.normalX[i], _triangles.normalY[i], _triangles.normalZ[i]));
+		material = _triangles.material[i];
+		break;
+	case kBox :
+		normal = Box(i).SurfaceNormal(ray, hit.time);
+		material = _boxes.material[i];
+		break;
+	case kMeshTriangle : {
+		glm::vec3 a = MeshVertex(_meshTriangles.vertex0[i]);
+		barycentric = hit.barycentric;
+		normal = glm::normalize(glm::cross(MeshVertex(_meshTriangles.vertex1[i]) - a, MeshVertex(_meshTriangles.vertex2[i]) - a));
+		material = _meshTriangles.material[i];
+		break;
+	}
+	default :
+		normal = glm::normalize(glm::vec3(_planes.normalX[i], _planes.normalY[i], _planes.normalZ[i]));
+		material = _planes.material[i];
+		break;
+	}
+	info.time = hit.time;
+	info.hitPoint = point;
+	info.normal = normal;
+	info.barycentric = barycentric;
+	info.material = &_materials[material];
+}
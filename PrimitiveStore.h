@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Object.h"
+#include "BoundingBox.h"
+#include "RayPacket.h"
+#include "Array.h"
+
+//The kinds of primitive the renderer can intersect
+//The bounded kinds come first, they are the ones that go into the BVH
+enum PrimitiveKind
+{
+	kSphere,
+	kTriangle,
+	kBox,
+	kMeshTriangle,
+	kPlane,
+	kNumPrimitiveKinds
+};
+
+//Number of kinds that have a bounding box (everything except planes)
+static const int kNumBoundedKinds = 4;
+
+//Identifies one primitive in a PrimitiveStore: its kind and its index among the primitives of that kind
+struct PrimitiveRef
+{
+	int kind;
+	int index;
+};
+
+//The closest hit found so far along a ray
+struct PrimitiveHit
+{
+	PrimitiveHit():
+		time(std::numeric_limits<float>::infinity()),
+		barycentric(0.0f)
+	{
+	}
+
+	float time; // Only hits closer than this are accepted
+	PrimitiveRef primitive; // The primitive hit, only valid once a hit has been found
+	glm::vec2 barycentric; // For a triangle hit, the weights of the second and third vertices from the intersection test
+};
+
+//Compact storage for all the primitives in a scene
+//Each kind of primitive is stored as a structure of arrays, e.g. all the sphere centre x coordinates together,
+//so a ray can be tested against a run of primitives of one kind in a tight loop with no virtual calls and no
+//pointer chasing. The materials are kept once in a shared table and each primitive holds an index into it
+class PrimitiveStore
+{
+public:
+	//Add a material to the table, unless an identical one is already there
+	//returns the index of the material
+	int AddMaterial(const Material &material);
+
+	//Add a primitive, returns its index among the primitives of that kind
+	//@material Index into the material table
+	int AddSphere(const glm::vec3 &centre, float radius, int material);
+	int AddPlane(const glm::vec3 &point, const glm::vec3 &normal, int material);
+	int AddTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, int material);
+	int AddBox(const glm::vec3 &corner1, const glm::vec3 &corner2, int material);
+
+	//Add a vertex for the faces of triangle meshes to share, returns its index
+	int AddMeshVertex(const glm::vec3 &position);
+
+	//Add a face of a triangle mesh, returns its index among the mesh faces
+	//@v0, v1, v2 The indices of the face's vertices, as returned by AddMeshVertex
+	int AddMeshTriangle(int v0, int v1, int v2, int material);
+
+	//Returns the number of mesh vertices
+	int MeshVertexCount() const { return (int)_meshVertices.x.size(); }
+
+	//Returns the number of primitives of a kind
+	int Count(int kind) const;
+
+	//Returns the total number of primitives of all kinds
+	int Size() const;
+
+	//Returns the bounding box of one of the bounded primitives
+	BoundingBox Bounds(const PrimitiveRef &primitive) const;
+
+	//Reorder the primitives of one kind, e.g. so that each leaf of the BVH covers a contiguous run of them
+	//@order The new order, order[i] is the current index of the primitive that should end up at index i
+	void Reorder(int kind, const vector<int> &order);
+
+	//Find the closest hit with a run of primitives of one kind
+	//@ray The ray that we are testing for intersection
+	//@first The index of the first primitive to test
+	//@count The number of primitives to test
+	//@hit The closest hit so far. Updated if one of the primitives is hit closer
+	//returns true if a closer hit was found
+	bool Intersect(int kind, const Ray &ray, int first, int count, PrimitiveHit &hit) const;
+
+	//Test whether any of a run of primitives of one kind is hit before tMax
+	bool Occluded(int kind, const Ray &ray, int first, int count, float tMax) const;
+
+	//Packet version of Intersect
+	//@time Per ray, the time of the closest hit so far. Updated where a closer hit is found. Rays with a time of 0 or less are ignored
+	//@hits Per ray, set to the closer hit where one is found
+	//returns the lanes in which a closer hit was found
+	SimdMask IntersectPacket(int kind, const RayPacket &packet, int first, int count, SimdFloat &time, PrimitiveHit hits[]) const;
+
+	//Packet version of Occluded
+	//@tMax Per ray, hits at or beyond this time along the ray are ignored. Rays with a tMax of 0 or less are ignored
+	//returns the lanes in which one of the primitives is in the way
+	SimdMask OccludedPacket(int kind, const RayPacket &packet, int first, int count, const SimdFloat &tMax) const;
+
+	//Work out the details of a hit already found by one of the intersection tests: the hit point, normal and material
+	//The hit is not tested again, so a lane that the SIMD tests found always stays a hit
+	//@hit The hit, as Intersect or IntersectPacket left it
+	void IntersectInfoFor(const Ray &ray, const PrimitiveHit &hit, IntersectInfo &info) const;
+
+	//Check arrays that were filled in from a scene cache rather than by the Add functions, so that a damaged cache
+	//can not send a lookup out of bounds
+	//returns false if the arrays of a kind differ in length or a material or mesh vertex index is out of range
+	bool Validate() const;
+
+	//Call f on each of the arrays that hold the primitives and materials, always in the same order
+	//Used to save the arrays to a scene cache and to attach them to the cache again when it is loaded
+	template<class F> void ForEachArray(F &f)
+	{
+		_spheres.ForEachArray(f);
+		_triangles.ForEachArray(f);
+		_boxes.ForEachArray(f);
+		_meshTriangles.ForEachArray(f);
+		_meshVertices.ForEachArray(f);
+		_planes.ForEachArray(f);
+		f(_materials);
+	}
+
+private:
+	//Find the time along the ray of the nearest intersection in front of the origin (if any) with one primitive
+	bool HitSphere(const Ray &ray, int i, float &time) const;
+	bool HitPlane(const Ray &ray, int i, float &time) const;
+	bool HitTriangle(const Ray &ray, int i, float &time, glm::vec2 &barycentric) const;
+	bool HitBox(const Ray &ray, int i, float &time) const;
+	bool HitMeshTriangle(const Ray &ray, int i, float &time, glm::vec2 &barycentric) const;
+
+	//Test one ray against a run of up to kSimdWidth consecutive triangles, one triangle per lane
+	//@count The number of triangles to test, the lanes past it always miss
+	//@time, barycentric Per triangle, set to the time and the barycentric coordinates of the hit
+	//returns the lanes whose triangle is hit
+	SimdMask HitTriangleBatch(const Ray &ray, int i, int count, SimdFloat &time, SimdFloat barycentric[2]) const;
+
+	SimdMask HitSpheres(const RayPacket &packet, int i, SimdFloat &time) const;
+	SimdMask HitPlanes(const RayPacket &packet, int i, SimdFloat &time) const;
+	SimdMask HitTriangles(const RayPacket &packet, int i, SimdFloat &time, SimdFloat barycentric[2]) const;
+	SimdMask HitBoxes(const RayPacket &packet, int i, SimdFloat &time) const;
+	SimdMask HitMeshTriangles(const RayPacket &packet, int i, SimdFloat &time, SimdFloat barycentric[2]) const;
+
+	//Returns the corners of a box
+	BoundingBox Box(int i) const
+	{
+		return BoundingBox(glm::vec3(_boxes.minX[i], _boxes.minY[i], _boxes.minZ[i]),
+		                   glm::vec3(_boxes.maxX[i], _boxes.maxY[i], _boxes.maxZ[i]));
+	}
+
+	//Returns the position of a mesh vertex
+	glm::vec3 MeshVertex(int v) const
+	{
+		return glm::vec3(_meshVertices.x[v], _meshVertices.y[v], _meshVertices.z[v]);
+	}
+
+	struct Spheres
+	{
+		Array<float> centreX, centreY, centreZ;
+		Array<float> radius;
+		Array<float> radius2; // The radius squared
+		Array<int> material;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(centreX); f(centreY); f(centreZ); f(radius); f(radius2); f(material);
+		}
+	};
+
+	struct Planes
+	{
+		Array<float> pointX, pointY, pointZ; // Any point on the plane
+		Array<float> normalX, normalY, normalZ; // The normalised normal
+		Array<int> material;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(pointX); f(pointY); f(pointZ); f(normalX); f(normalY); f(normalZ); f(material);
+		}
+	};
+
+	struct Triangles
+	{
+		Array<float> aX, aY, aZ; // The first vertex
+		Array<float> uX, uY, uZ; // The edge from the first vertex to the second, precomputed for the intersection test
+		Array<float> vX, vY, vZ; // The edge from the first vertex to the third
+		Array<float> normalX, normalY, normalZ; // The normalised normal
+		Array<int> material;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(aX); f(aY); f(aZ); f(uX); f(uY); f(uZ); f(vX); f(vY); f(vZ);
+			f(normalX); f(normalY); f(normalZ); f(material);
+		}
+	};
+
+	struct Boxes
+	{
+		Array<float> minX, minY, minZ;
+		Array<float> maxX, maxY, maxZ;
+		Array<int> material;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(minX); f(minY); f(minZ); f(maxX); f(maxY); f(maxZ); f(material);
+		}
+	};
+
+	//The faces of triangle meshes. A face only holds the indices of its vertices, so a vertex shared by
+	//several faces is stored once. Around 16 bytes per face against 52 for a separate triangle
+	struct MeshTriangles
+	{
+		Array<int> vertex0, vertex1, vertex2; // Indices into MeshVertices
+		Array<int> material;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(vertex0); f(vertex1); f(vertex2); f(material);
+		}
+	};
+
+	//The vertices of all the triangle meshes. Reordering the faces leaves these where they are
+	struct MeshVertices
+	{
+		Array<float> x, y, z;
+
+		template<class F> void ForEachArray(F &f)
+		{
+			f(x); f(y); f(z);
+		}
+	};
+
+	Spheres _spheres;
+	Planes _planes;
+	Triangles _triangles;
+	Boxes _boxes;
+	MeshTriangles _meshTriangles;
+	MeshVertices _meshVertices;
+	Array<Material> _materials;
+};
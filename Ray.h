@@ -12,10 +12,12 @@ class Ray
 public:
 	glm::vec3 origin;
 	glm::vec3 direction;
+	glm::vec3 invDirection; // 1 / direction - used by the bounding box slab test
 
 	Ray(const glm::vec3 &origin, const glm::vec3 &direction):
 		origin(origin),
-		direction(direction)
+		direction(direction),
+		invDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z)
 	{
 	}
 
@@ -35,6 +37,7 @@ public:
 		time(std::numeric_limits<float>::infinity()),
 		hitPoint(0.0f),
 		normal(0.0f),
+		barycentric(0.0f),
 		material(NULL)
 	{
 	}
@@ -43,6 +46,8 @@ public:
 	glm::vec3 hitPoint;
 	//The normal vector of the surface at the point of the intersection
 	glm::vec3 normal;
+	//For triangles, the barycentric coordinates of the intersection: the weights of the second and third vertices
+	glm::vec2 barycentric;
 	//The time along the ray that the intersection occurs
 	float time;
 	//The material of the object that was intersected
@@ -54,6 +59,7 @@ public:
 		hitPoint = rhs.hitPoint;
 		material = rhs.material;
 		normal = rhs.normal;
+		barycentric = rhs.barycentric;
 		time = rhs.time;
 		return *this;
 	}
@@ -66,10 +72,12 @@ public:
 	Payload():
 		color(0.0f),
 		numBounces(0),
-		shadowed(false)
+		shadowed(false),
+		randomState(0)
 	{
 	}
 	glm::vec3 color;			// Accumulated color of this ray.
 	int numBounces;				// Number of bounces this ray has made so far.
 	bool shadowed; 				// Is the point occluded from the lightsource?
+	unsigned int randomState;	// Seed for the random numbers used along this ray's path, e.g. the pixel index
 };
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Ray.h"
+#include "Simd.h"
+
+//A bundle of kSimdWidth rays that are traced together, e.g. the primary rays of neighbouring pixels
+//The rays are stored as a structure of arrays so that each component of all the rays sits in one SIMD register
+//and a single instruction works on every ray in the packet
+class RayPacket
+{
+public:
+	//Constructor
+	//@rays The rays to pack
+	//@count The number of rays, at most kSimdWidth. The spare lanes repeat the last ray and should be masked off
+	RayPacket(const Ray *rays, int count)
+	{
+		float values[9][kSimdWidth];
+		for (int lane = 0; lane < kSimdWidth; ++lane) {
+			const Ray &ray = rays[glm::min(lane, count - 1)];
+			for (int axis = 0; axis < 3; ++axis) {
+				values[axis][lane] = ray.origin[axis];
+				values[3 + axis][lane] = ray.direction[axis];
+				values[6 + axis][lane] = ray.invDirection[axis];
+			}
+		}
+		for (int axis = 0; axis < 3; ++axis) {
+			origin[axis] = SimdFloat::Load(values[axis]);
+			direction[axis] = SimdFloat::Load(values[3 + axis]);
+			invDirection[axis] = SimdFloat::Load(values[6 + axis]);
+		}
+	}
+
+	SimdFloat origin[3]; // x, y and z of the origins
+	SimdFloat direction[3]; // x, y and z of the normalised directions
+	SimdFloat invDirection[3]; // 1 / direction, for the bounding box slab test
+};
+
+//Dot product of a vector per lane with a single vector
+inline SimdFloat Dot(const SimdFloat v[3], const glm::vec3 &w)
+{
+	return v[0] * SimdFloat(w.x) + v[1] * SimdFloat(w.y) + v[2] * SimdFloat(w.z);
+}
+
+//Dot product of two vectors per lane
+inline SimdFloat Dot(const SimdFloat v[3], const SimdFloat w[3])
+{
+	return v[0] * w[0] + v[1] * w[1] + v[2] * w[2];
+}
+
+//Cross product of two vectors per lane
+inline void Cross(const SimdFloat v[3], const SimdFloat w[3], SimdFloat result[3])
+{
+	result[0] = v[1] * w[2] - v[2] * w[1];
+	result[1] = v[2] * w[0] - v[0] * w[2];
+	result[2] = v[0] * w[1] - v[1] * w[0];
+}
+
+//Load count floats, at most kSimdWidth, e.g. at the end of an array. The remaining lanes are set to 0
+inline SimdFloat LoadPartial(const float *p, int count)
+{
+	if (count == kSimdWidth) {
+		return SimdFloat::Load(p);
+	}
+#if defined(RT_SIMD_AVX)
+	// A masked load fills the lanes straight from memory. Copying the floats through a buffer instead stalls the
+	// wide load until the separate narrow stores are done, which costs more than the test the values are for
+	__m256 lanes = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	__m256 mask = _mm256_cmp_ps(lanes, _mm256_set1_ps((float)count), _CMP_LT_OQ);
+	return SimdFloat(_mm256_maskload_ps(p, _mm256_castps_si256(mask)));
+#else
+	float values[kSimdWidth] = {};
+	for (int lane = 0; lane < count; ++lane) {
+		values[lane] = p[lane];
+	}
+	return SimdFloat::Load(values);
+#endif
+}
@@ -0,0 +1,71 @@
+#include "RenderStats.h"
+
+#ifdef RT_STATS
+
+#include <mutex>
+
+// The counters of every thread that has counted anything. Only locked when a thread counts for the first time
+// and when the counters are reported, never while a ray is traced
+static mutex registryLock;
+static vector<unique_ptr<RenderStatCounters>> registry;
+
+// The names of the counters in the JSON report, in the order of RenderStat and RenderPhase
+static const char *const statNames[kNumRenderStats] = {
+	"primary_rays", "shadow_rays", "reflection_rays", "ray_hits", "ray_misses", "shadow_rays_blocked",
+	"paths", "bounces", "edge_pixels", "node_tests", "sphere_tests", "triangle_tests", "box_tests",
+	"mesh_triangle_tests", "plane_tests"
+};
+static const char *const phaseNames[kNumRenderPhases] = { "render_seconds", "trace_seconds", "draw_seconds" };
+
+RenderStatCounters *NewThreadRenderStats()
+{
+	unique_ptr<RenderStatCounters> counters(new RenderStatCounters());
+	lock_guard<mutex> guard(registryLock);
+	registry.push_back(move(counters));
+	return registry.back().get();
+}
+
+void ReportRenderStats(int frame, ostream *json)
+{
+	RenderStatCounters total = RenderStatCounters();
+	{
+		lock_guard<mutex> guard(registryLock);
+		for (size_t i = 0; i < registry.size(); ++i) {
+			for (int stat = 0; stat < kNumRenderStats; ++stat) {
+				total.counts[stat] += registry[i]->counts[stat];
+				registry[i]->counts[stat] = 0;
+			}
+			for (int phase = 0; phase < kNumRenderPhases; ++phase) {
+				total.seconds[phase] += registry[i]->seconds[phase];
+				registry[i]->seconds[phase] = 0.0;
+			}
+		}
+	}
+	const long long *counts = total.counts;
+	double averageBounces = counts[kPaths] > 0 ? (double)counts[kBounces] / counts[kPaths] : 0.0;
+
+	cout << "Frame " << frame << ": " << counts[kPrimaryRays] << " primary, " << counts[kShadowRays] << " shadow and "
+	     << counts[kReflectionRays] << " reflection rays" << endl;
+	cout << "  " << counts[kRayHits] << " hits, " << counts[kRayMisses] << " misses, " << counts[kShadowRaysBlocked]
+	     << " shadow rays blocked, " << averageBounces << " bounces per path, " << counts[kEdgePixels]
+	     << " edge pixels anti-aliased" << endl;
+	cout << "  Tests: " << counts[kNodeTests] << " BVH nodes, " << counts[kSphereTests] << " spheres, "
+	     << counts[kTriangleTests] << " triangles, " << counts[kBoxTests] << " boxes, " << counts[kMeshTriangleTests]
+	     << " mesh triangles, " << counts[kPlaneTests] << " planes" << endl;
+	cout << "  Time: " << total.seconds[kRenderPhase] << " s rendering (" << total.seconds[kTracePhase]
+	     << " s over all threads), " << total.seconds[kDrawPhase] << " s drawing" << endl;
+
+	if (json != NULL) {
+		*json << "{\"frame\": " << frame;
+		for (int stat = 0; stat < kNumRenderStats; ++stat) {
+			*json << ", \"" << statNames[stat] << "\": " << counts[stat];
+		}
+		*json << ", \"average_bounces\": " << averageBounces;
+		for (int phase = 0; phase < kNumRenderPhases; ++phase) {
+			*json << ", \"" << phaseNames[phase] << "\": " << total.seconds[phase];
+		}
+		*json << "}" << endl;
+	}
+}
+
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "header.h"
+
+#include <chrono>
+
+//Counters of the work done to render a frame: the rays cast, the intersection tests and where the time goes
+//They only exist in a build with RT_STATS defined (make STATSFLAGS=-DRT_STATS). Otherwise the RT_STAT macros
+//below expand to nothing, so the normal build has no trace of them and runs at full speed
+//Each thread adds to its own set of counters, so the render threads never wait for each other. The sets are
+//only added up once a frame is finished, by ReportRenderStats
+
+//The things that are counted
+//A packet test counts once for each lane of the packet, the same as testing the rays one at a time would
+enum RenderStat
+{
+	kPrimaryRays,
+	kShadowRays,
+	kReflectionRays,
+	kRayHits, // Primary and reflection rays that hit something
+	kRayMisses, // Primary and reflection rays that hit nothing
+	kShadowRaysBlocked, // Shadow rays that found something between the hit point and the light
+	kPaths, // Primary rays that hit something, each of which has its reflections followed
+	kBounces, // Payload::numBounces added up over the paths
+	kEdgePixels, // Pixels found on an edge and traced again with several samples (see RenderSettings::antialiasGrid)
+	kNodeTests, // Tests of a ray against the bounding box of a BVH node
+	kSphereTests, // Tests of a ray against one primitive, one counter per kind in the order of PrimitiveKind
+	kTriangleTests,
+	kBoxTests,
+	kMeshTriangleTests,
+	kPlaneTests,
+	kNumRenderStats
+};
+
+//The parts of a frame that are timed
+enum RenderPhase
+{
+	kRenderPhase, // Rendering tiles, from start to finish
+	kTracePhase, // Tracing tiles, added up over all the threads, so up to the number of threads times kRenderPhase
+	kDrawPhase, // Copying the image to the window
+	kNumRenderPhases
+};
+
+#ifdef RT_STATS
+
+//The counters of one thread
+struct RenderStatCounters
+{
+	long long counts[kNumRenderStats];
+	double seconds[kNumRenderPhases];
+	char padding[64]; // Keeps the counters of another thread off the last cache line
+};
+
+//Create and zero the counters of the calling thread. They are kept until the program exits
+RenderStatCounters *NewThreadRenderStats();
+
+//Returns the counters of the calling thread, which no other thread writes to
+inline RenderStatCounters &ThreadRenderStats()
+{
+	static thread_local RenderStatCounters *counters = NULL;
+	if (counters == NULL) {
+		counters = NewThreadRenderStats();
+	}
+	return *counters;
+}
+
+//Returns the number of intersection tests, of BVH nodes and primitives, that the calling thread has counted so far
+inline long long ThreadIntersectionTests()
+{
+	const RenderStatCounters &counters = ThreadRenderStats();
+	long long tests = counters.counts[kNodeTests];
+	for (int stat = kSphereTests; stat <= kPlaneTests; ++stat) {
+		tests += counters.counts[stat];
+	}
+	return tests;
+}
+
+//Adds the time from its construction to its destruction to a phase of the calling thread
+class RenderPhaseTimer
+{
+public:
+	explicit RenderPhaseTimer(RenderPhase phase):
+		_phase(phase),
+		_start(chrono::steady_clock::now())
+	{
+	}
+
+	~RenderPhaseTimer()
+	{
+		ThreadRenderStats().seconds[_phase] += chrono::duration<double>(chrono::steady_clock::now() - _start).count();
+	}
+
+private:
+	RenderPhase _phase;
+	chrono::steady_clock::time_point _start;
+};
+
+//Add up the counters of every thread, print them, and set them all back to zero for the next frame
+//Must only be called while no other thread is rendering, e.g. between calls to RenderTiles
+//@frame The number of the frame, to label the report
+//@json If not NULL, the totals are also written to it as one line of JSON
+void ReportRenderStats(int frame, ostream *json);
+
+//Add amount to a counter of the calling thread
+#define RT_STAT_ADD(stat, amount) (ThreadRenderStats().counts[stat] += (amount))
+//Time the rest of the enclosing block as part of a phase
+#define RT_STAT_TIME(phase) RenderPhaseTimer phaseTimer_##phase(phase)
+
+#else
+
+//Nothing is counted without RT_STATS
+inline long long ThreadIntersectionTests() { return 0; }
+
+#define RT_STAT_ADD(stat, amount) ((void)0)
+#define RT_STAT_TIME(phase) ((void)0)
+
+#endif
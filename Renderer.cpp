@@ -0,0 +1,1136 @@
+#include "Renderer.h"
+#include "RenderStats.h"
+#include "Timeline.h"
+
+#include <chrono>
+
+// The pixels are rendered in square tiles of this size, each tile is one task for the thread pool
+static const int tileSize = 16;
+
+// The control panel features that change how a ray is traced. The tracing functions are templates on a mask of
+// these with one instantiation for every combination, so the features are tested once per frame to pick the
+// instantiation rather than for every ray, and the code of a feature that is off is left out altogether
+enum RenderFeature
+{
+	kShadowsFeature = 1,
+	kPhongFeature = 2,
+	kReflectionsFeature = 4,
+	kNumFeatureMasks = 8
+};
+
+// Returns the mask of the features switched on in the settings
+static int FeatureMask(const RenderSettings &settings)
+{
+	return (settings.activateShadows ? kShadowsFeature : 0) |
+	       (settings.activatePhong ? kPhongFeature : 0) |
+	       (settings.activateReflections ? kReflectionsFeature : 0);
+}
+
+//Move the collision point slightly up the normal to avoid shadow ray colliding again
+static glm::vec3 OffsetHitPoint(const IntersectInfo &info)
+{
+	return info.hitPoint + (0.1f * info.normal);
+}
+
+//Set up the ray from a hit point towards the light
+//@lightDist Set to the distance from the start of the ray to the light
+static Ray ShadowRay(const Scene &scene, const IntersectInfo &info, float &lightDist)
+{
+	glm::vec3 hitPoint_fix = OffsetHitPoint(info);
+	lightDist = glm::distance(hitPoint_fix, scene.lightPos);
+	return Ray(	hitPoint_fix, 	//The origin of the ray we are casting
+	            glm::normalize(glm::vec3(scene.lightPos - hitPoint_fix))		//The direction the ray is travelling in
+	          );
+}
+
+//Work out the colour of a hit point from the light alone, not counting any reflections
+//@scene The scene being rendered
+//@ray The ray that hit the point
+//@info The intersection of the ray with the scene
+//@shadowed Whether the point is in shadow (only used if shadows are on)
+template<int Features>
+static glm::vec3 LocalColour(const Scene &scene, const Ray &ray, const IntersectInfo &info, bool shadowed)
+{
+	glm::vec3 hitPoint_fix = OffsetHitPoint(info);
+
+	// Initialize a normal vector pointing towards the light source
+	// PL = L - P
+	glm::vec3 lightVec = glm::normalize(glm::vec3(scene.lightPos - hitPoint_fix));
+
+	if (Features & kPhongFeature) {
+		// Compute Phong illumination
+		glm::vec3 normOut = info.normal;
+		if (glm::dot(lightVec, normOut) < 0) {
+			normOut = -1.0f * normOut;
+		}
+		glm::vec3 eyeVec = glm::normalize(ray.origin - hitPoint_fix);
+		// Intensity constants
+		float light_source_intensity = 1.0;
+		float specular_intensity = info.material->specularExponent;
+
+		// Reflectivity constants
+		float diffuse_reflectivity = 0.6;
+		float specular_reflectivity = 0.8;
+
+		// Ambient lighting constant
+		float ambient_lighting = 0.1;
+
+		// Dot product : a . b = |a||b|cosø
+		// |lightVec| == |normOut| == 1
+		// So lightVec . normOut = cosø
+		float cosine_theta = glm::max(0.0f, abs(glm::dot(lightVec, normOut)));
+
+		// cos(a) = (2N(L.N)-L).V
+		float cosine_alpha = glm::max(0.0f, glm::dot(((2.0f * normOut * (glm::dot(lightVec, normOut))) - lightVec), eyeVec));
+
+		// Using the equations in the coursework pdf
+		float diff    = light_source_intensity * diffuse_reflectivity * cosine_theta;
+		float spec    = light_source_intensity * specular_reflectivity * pow(cosine_alpha, specular_intensity);
+		float ambient = ambient_lighting;
+
+		glm::vec3 diffMat = info.material->diffuse;
+		glm::vec3 specMat = info.material->specular;
+		glm::vec3 ambMat = info.material->ambient;
+
+		// Only use the ambient lighting if the pixel is in shadow
+		if (shadowed) {
+			diff = 0;
+			spec = 0;
+		}
+
+		// Calculate the RGB colour using the Material
+		float red_free = (diff * diffMat.x) + (spec * specMat.x) + (ambient * ambMat.x);
+		float green_free = (diff * diffMat.y) + (spec * specMat.y) + (ambient * ambMat.y);
+		float blue_free = (diff * diffMat.z) + (spec * specMat.z) + (ambient * ambMat.z);
+		
+		// Constrain the colour floats to [0,1]
+		float red   = glm::max(0.0f, glm::min(1.0f, red_free));
+		float green = glm::max(0.0f, glm::min(1.0f, green_free));
+		float blue  = glm::max(0.0f, glm::min(1.0f, blue_free));
+
+		//Toggles Phong on and off
+		return info.material->Klocal * glm::vec3(red, green, blue);
+	}
+	else {
+		if (Features & kShadowsFeature) {
+			if (shadowed) {
+				return glm::vec3(0.0f);
+			}
+			else {
+				return info.material->Klocal * info.material->ambient;
+			}
+		}
+		else {
+			// No shadows and no Phong so just colour everything by its ambient colour
+			return info.material->Klocal * info.material->ambient;
+		}
+	}
+
+}
+
+//A small, fast hash based random number generator, one per pixel so that renders are repeatable
+//@state Advanced each time a number is drawn
+//returns a number in [0, 1)
+static float NextRandom(unsigned int &state)
+{
+	state = state * 747796405u + 2891336453u;
+	unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	word = (word >> 22u) ^ word;
+	return (word >> 8) * (1.0f / 16777216.0f);
+}
+
+//Follow the path of a ray from its first hit, adding up the colour of each surface it bounces off
+//Reflections are followed in a loop rather than by recursion. The throughput is the product of the
+//reflectivities along the path so far, i.e. how much the next surface can add to the pixel, and the
+//path ends once it gets too small to matter
+//@scene The scene being rendered
+//@ray The ray that made the first hit
+//@info The first hit
+//@payload Information on the ray. payload.shadowed must already say whether the first hit is in shadow
+//@settings The control panel settings for this frame
+template<int Features>
+static void TracePath(const Scene &scene, const Ray &ray, IntersectInfo info, Payload &payload, const RenderSettings &settings)
+{
+	Ray current = ray;
+	float throughput = 1.0f;
+	for (;;) {
+		payload.color += throughput * LocalColour<Features>(scene, current, info, payload.shadowed);
+
+		// The reflection rays - adapted from the lecture slides
+		if (!(Features & kReflectionsFeature)) {
+			return;
+		}
+		payload.numBounces++;
+		if (info.material->Kreflectivity <= 0 || payload.numBounces > settings.maxReflections) {
+			return;
+		}
+		throughput *= info.material->Kreflectivity;
+		if (throughput < settings.minThroughput) {
+			if (!settings.russianRoulette) {
+				return;
+			}
+			// Carry on with a probability in proportion to the throughput and weight up the survivors to make up for
+			// the paths that were ended, so the image stays correct on average
+			float survival = throughput / settings.minThroughput;
+			if (NextRandom(payload.randomState) >= survival) {
+				return;
+			}
+			throughput = settings.minThroughput;
+		}
+
+		// r = i - 2N(i.n)
+		glm::vec3 reflDir = glm::normalize(current.direction - 2.0f * info.normal * (glm::dot(current.direction, info.normal)));
+		current = Ray(	OffsetHitPoint(info), 	//The origin of the ray we are casting
+		                reflDir		//The direction the ray is travelling in
+		             );
+		RT_STAT_ADD(kReflectionRays, 1);
+		if (!scene.Intersect(current, info)) {
+			RT_STAT_ADD(kRayMisses, 1);
+			return; // Reflections of the empty background add nothing
+		}
+		RT_STAT_ADD(kRayHits, 1);
+		payload.shadowed = false;
+		if (Features & kShadowsFeature) {
+			float lightDist;
+			Ray shadowRay = ShadowRay(scene, info, lightDist);
+			payload.shadowed = scene.Occluded(shadowRay, lightDist);
+			RT_STAT_ADD(kShadowRays, 1);
+			RT_STAT_ADD(kShadowRaysBlocked, payload.shadowed);
+		}
+	}
+}
+
+// Shade a primary hit: cast its shadow ray and follow its reflections
+//@ray The primary ray
+//@info Where the ray hit
+//@payload Receives the colour of the path
+template<int Features>
+static void ShadeHitFor(const Scene &scene, const Ray &ray, const IntersectInfo &info, Payload &payload, const RenderSettings &settings)
+{
+	if (Features & kShadowsFeature) {
+		// Cast the shadow ray - the point is in shadow if anything is hit before the light
+		float lightDist;
+		Ray shadowRay = ShadowRay(scene, info, lightDist);
+		payload.shadowed = scene.Occluded(shadowRay, lightDist);
+		RT_STAT_ADD(kShadowRays, 1);
+		RT_STAT_ADD(kShadowRaysBlocked, payload.shadowed);
+	}
+	TracePath<Features>(scene, ray, info, payload, settings);
+	RT_STAT_ADD(kPaths, 1);
+	RT_STAT_ADD(kBounces, payload.numBounces);
+}
+
+// CastRay for one feature mask
+//@info Receives the first hit, if there is one
+template<int Features>
+static float CastRayFor(const Scene &scene, const Ray &ray, Payload &payload, IntersectInfo &info, const RenderSettings &settings)
+{
+	//Check if the ray intersects something
+	RT_STAT_ADD(kPrimaryRays, 1);
+	if (scene.Intersect(ray, info)) {
+		RT_STAT_ADD(kRayHits, 1);
+		ShadeHitFor<Features>(scene, ray, info, payload, settings);
+		return info.time;
+	}
+	RT_STAT_ADD(kRayMisses, 1);
+	return 0.0f;
+}
+
+// Shade a packet of primary hits, the shadow rays are traced together as a packet
+//@rays The primary rays
+//@count The number of rays, at most kSimdWidth
+//@infos, hit Per ray, where it hit and whether it hit anything at all
+//@payloads Per ray, receives the colour of the path
+//@times Per ray, set to the time of the hit or zero if the ray hit nothing
+template<int Features>
+static void ShadeHitsFor(const Scene &scene, const Ray *rays, int count, const IntersectInfo *infos, const bool *hit,
+                         Payload *payloads, float *times, const RenderSettings &settings)
+{
+	// The shadow rays of neighbouring pixels all head for the same light so trace them as a packet too
+	bool anyHit = false;
+	for (int lane = 0; lane < count; ++lane) {
+		anyHit = anyHit || hit[lane];
+	}
+	if ((Features & kShadowsFeature) && anyHit) {
+		vector<Ray> shadowRays;
+		shadowRays.reserve(kSimdWidth);
+		float lightDists[kSimdWidth];
+		for (int lane = 0; lane < kSimdWidth; ++lane) {
+			lightDists[lane] = 0.0f;
+			if (lane < count && hit[lane]) {
+				shadowRays.push_back(ShadowRay(scene, infos[lane], lightDists[lane]));
+				RT_STAT_ADD(kShadowRays, 1);
+			}
+			else {
+				shadowRays.push_back(rays[glm::min(lane, count - 1)]); // switched off by the tMax of 0
+			}
+		}
+		int shadowBits = scene.OccludedPacket(RayPacket(&shadowRays[0], kSimdWidth), SimdFloat::Load(lightDists)).Bits();
+		for (int lane = 0; lane < count; ++lane) {
+			payloads[lane].shadowed = (shadowBits & (1 << lane)) != 0;
+			RT_STAT_ADD(kShadowRaysBlocked, payloads[lane].shadowed);
+		}
+	}
+
+	// Shading and reflections go one ray at a time
+	TimelineScope timelineScope("Shade");
+	for (int lane = 0; lane < count; ++lane) {
+		times[lane] = 0.0f;
+		if (hit[lane]) {
+			TracePath<Features>(scene, rays[lane], infos[lane], payloads[lane], settings);
+			times[lane] = infos[lane].time;
+			RT_STAT_ADD(kPaths, 1);
+			RT_STAT_ADD(kBounces, payloads[lane].numBounces);
+		}
+	}
+}
+
+// CastRayPacket for one feature mask
+//@infos Per ray, receives the first hit, if there is one
+template<int Features>
+static void CastRayPacketFor(const Scene &scene, const Ray *rays, int count, Payload *payloads, float *times,
+                             IntersectInfo *infos, const RenderSettings &settings)
+{
+	// Find the closest hits of all the rays together, spare lanes are switched off with a time of 0
+	float startTimes[kSimdWidth];
+	for (int lane = 0; lane < kSimdWidth; ++lane) {
+		startTimes[lane] = lane < count ? std::numeric_limits<float>::infinity() : 0.0f;
+	}
+	SimdFloat time = SimdFloat::Load(startTimes);
+	PrimitiveHit hits[kSimdWidth];
+	RayPacket packet(rays, count);
+	int hitBits = scene.IntersectPacket(packet, time, hits).Bits();
+
+	// Fill in the hit point, normal and material of each ray from the hit the packet test found
+	bool hit[kSimdWidth];
+	for (int lane = 0; lane < count; ++lane) {
+		hit[lane] = (hitBits & (1 << lane)) != 0;
+		if (hit[lane]) {
+			scene.IntersectInfoFor(rays[lane], hits[lane], infos[lane]);
+		}
+		RT_STAT_ADD(hit[lane] ? kRayHits : kRayMisses, 1);
+	}
+	RT_STAT_ADD(kPrimaryRays, count);
+
+	ShadeHitsFor<Features>(scene, rays, count, infos, hit, payloads, times, settings);
+}
+
+// The instantiations for every feature mask, indexed by the mask
+typedef float (*CastRayFunction)(const Scene &, const Ray &, Payload &, IntersectInfo &, const RenderSettings &);
+static const CastRayFunction castRayFunctions[kNumFeatureMasks] = {
+	CastRayFor<0>, CastRayFor<1>, CastRayFor<2>, CastRayFor<3>,
+	CastRayFor<4>, CastRayFor<5>, CastRayFor<6>, CastRayFor<7>
+};
+
+typedef void (*CastRayPacketFunction)(const Scene &, const Ray *, int, Payload *, float *, IntersectInfo *, const RenderSettings &);
+static const CastRayPacketFunction castRayPacketFunctions[kNumFeatureMasks] = {
+	CastRayPacketFor<0>, CastRayPacketFor<1>, CastRayPacketFor<2>, CastRayPacketFor<3>,
+	CastRayPacketFor<4>, CastRayPacketFor<5>, CastRayPacketFor<6>, CastRayPacketFor<7>
+};
+
+float CastRay(const Scene &scene, const Ray &ray, Payload &payload, const RenderSettings &settings)
+{
+	IntersectInfo info;
+	return castRayFunctions[FeatureMask(settings)](scene, ray, payload, info, settings);
+}
+
+void CastRayPacket(const Scene &scene, const Ray *rays, int count, Payload *payloads, float *times, const RenderSettings &settings)
+{
+	IntersectInfo infos[kSimdWidth];
+	castRayPacketFunctions[FeatureMask(settings)](scene, rays, count, payloads, times, infos, settings);
+}
+
+//Returns the position of a tile along a Morton (Z-order) curve, which interleaves the bits of the coordinates
+static unsigned MortonIndex(unsigned x, unsigned y)
+{
+	unsigned index = 0;
+	for (unsigned bit = 0; bit < 16; ++bit) {
+		index |= ((x >> bit) & 1) << (2 * bit);
+		index |= ((y >> bit) & 1) << (2 * bit + 1);
+	}
+	return index;
+}
+
+//Returns the position of a tile along a Hilbert curve over an n by n grid, where n is a power of two
+//Unlike the Morton curve this never jumps, every tile is next to the one before it
+static unsigned HilbertIndex(unsigned n, unsigned x, unsigned y)
+{
+	unsigned index = 0;
+	for (unsigned s = n / 2; s > 0; s /= 2) {
+		unsigned rx = (x & s) != 0;
+		unsigned ry = (y & s) != 0;
+		index += s * s * ((3 * rx) ^ ry);
+		// Turn the quadrant round so that the curve inside it joins up with its neighbours
+		if (ry == 0) {
+			if (rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			swap(x, y);
+		}
+	}
+	return index;
+}
+
+const char *PixelOrderName(PixelOrder order)
+{
+	static const char *const names[kNumPixelOrders] = { "column", "row", "tiled", "morton", "hilbert" };
+	return names[order];
+}
+
+TileSchedule::TileSchedule():
+	_width(0),
+	_height(0),
+	_order(kTiledOrder)
+{
+}
+
+TileSchedule::TileSchedule(int width, int height, PixelOrder order):
+	_width(width),
+	_height(height),
+	_order(order)
+{
+	if (order == kColumnMajorOrder || order == kRowMajorOrder) {
+		// Strips as tall (or as wide) as the image, one tile size across
+		bool columns = order == kColumnMajorOrder;
+		int length = columns ? width : height;
+		for (int start = 0; start < length; start += tileSize) {
+			Tile tile = { 0, 0, width, height };
+			if (columns) {
+				tile.startColumn = start;
+				tile.endColumn = glm::min(start + tileSize, width);
+			}
+			else {
+				tile.startRow = start;
+				tile.endRow = glm::min(start + tileSize, height);
+			}
+			_tiles.push_back(tile);
+		}
+		return;
+	}
+
+	// Square tiles, sorted by their position along the curve. The curves cover a square grid with a power of two
+	// side, the positions of any tiles beyond the edge of the image are simply not used
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (height + tileSize - 1) / tileSize;
+	unsigned gridSize = 1;
+	while (gridSize < (unsigned)glm::max(tilesX, tilesY)) {
+		gridSize *= 2;
+	}
+	vector<pair<unsigned, Tile>> sorted;
+	for (int y = 0; y < tilesY; ++y) {
+		for (int x = 0; x < tilesX; ++x) {
+			Tile tile = { x * tileSize, y * tileSize, glm::min((x + 1) * tileSize, width), glm::min((y + 1) * tileSize, height) };
+			unsigned index = (unsigned)sorted.size();
+			if (order == kMortonOrder) {
+				index = MortonIndex(x, y);
+			}
+			else if (order == kHilbertOrder) {
+				index = HilbertIndex(gridSize, x, y);
+			}
+			sorted.push_back(make_pair(index, tile));
+		}
+	}
+	sort(sorted.begin(), sorted.end(), [](const pair<unsigned, Tile> &a, const pair<unsigned, Tile> &b) {
+		return a.first < b.first;
+	});
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		_tiles.push_back(sorted[i].second);
+	}
+}
+
+// RenderTiles for one feature mask, so the rays of every pixel go straight to the matching instantiation
+//@costs If not NULL, receives what each pixel cost to trace (see RenderImage)
+template<int Features>
+static void RenderTilesFor(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int blockSize, bool refine,
+                           int firstTile, int numTiles, vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels,
+                           vector<IntersectInfo> *primaryHits, vector<PixelCost> *costs)
+{
+	int width = schedule.Width();
+	int height = schedule.Height();
+	//Everything about the primary rays that is the same for every pixel
+	CameraRays cameraRays(scene.camera, width, height);
+
+	//Render the tiles in parallel, each one writes only its own pixels of the framebuffer
+	threadPool.ParallelFor(numTiles, [&](int task) {
+		RT_STAT_TIME(kTracePhase);
+		TimelineScope timelineScope("Tile", "tile", firstTile + task);
+		const TileSchedule::Tile &tile = schedule[firstTile + task];
+		int endColumn = tile.endColumn;
+		int endRow = tile.endRow;
+
+		//The tile is traced a line at a time: a row, or a column if the schedule is column-major
+		bool columnMajor = schedule.ColumnMajor();
+		int startLine = columnMajor ? tile.startColumn : tile.startRow;
+		int endLine = columnMajor ? tile.endColumn : tile.endRow;
+		int startAlong = columnMajor ? tile.startRow : tile.startColumn;
+		int endAlong = columnMajor ? tile.endRow : tile.endColumn;
+
+		//Stores the colour traced for a pixel in every pixel of its block
+		//The tile size is a multiple of the block size so blocks never cross into another tile
+		auto setPixel = [&](int column, int row, const glm::vec3 &color, const IntersectInfo &hit) {
+			glm::uint packed = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+			for (int blockRow = row; blockRow < glm::min(row + blockSize, endRow); ++blockRow) {
+				for (int blockColumn = column; blockColumn < glm::min(column + blockSize, endColumn); ++blockColumn) {
+					framebuffer[blockRow * width + blockColumn] = color;
+					if (displayPixels != NULL) {
+						(*displayPixels)[(height - 1 - blockRow) * width + blockColumn] = packed;
+					}
+					if (primaryHits != NULL) {
+						(*primaryHits)[blockRow * width + blockColumn] = hit;
+					}
+				}
+			}
+		};
+
+		//When refining, the pixels on the grid of the previous pass (twice the block size) already have their final colour
+		auto alreadyTraced = [&](int column, int row) {
+			return refine && column % (2 * blockSize) == 0 && row % (2 * blockSize) == 0;
+		};
+
+		//The pixels of a packet are traced together, so their costs could not be told apart
+		if (settings.packetTracing && costs == NULL) {
+			//Trace runs of up to kSimdWidth neighbouring samples along each line of the tile as one packet
+			vector<Ray> rays;
+			int columns[kSimdWidth];
+			int rows[kSimdWidth];
+			Payload payloads[kSimdWidth];
+			float times[kSimdWidth];
+			IntersectInfo infos[kSimdWidth];
+			for (int line = startLine; line < endLine; line += blockSize) {
+				int count = 0;
+				for (int along = startAlong; along < endAlong; along += blockSize) {
+					int column = columnMajor ? line : along;
+					int row = columnMajor ? along : line;
+					if (!alreadyTraced(column, row)) {
+						if (count == 0) {
+							rays.clear();
+						}
+						columns[count] = column;
+						rows[count] = row;
+						rays.push_back(cameraRays.PrimaryRay(column, row));
+						payloads[count] = Payload();
+						payloads[count].randomState = row * width + column;
+						++count;
+					}
+					if (count == kSimdWidth || (count > 0 && along + blockSize >= endAlong)) {
+						CastRayPacketFor<Features>(scene, &rays[0], count, payloads, times, infos, settings);
+						for (int lane = 0; lane < count; ++lane) {
+							//Default color is white, time > 0.0f indicates an intersection
+							if (times[lane] > 0.0f) {
+								setPixel(columns[lane], rows[lane], payloads[lane].color, infos[lane]);
+							}
+							else {
+								setPixel(columns[lane], rows[lane], glm::vec3(1.0f), IntersectInfo());
+							}
+						}
+						count = 0;
+					}
+				}
+			}
+			return;
+		}
+
+		//Iterate over each pixel in the tile
+		for (int line = startLine; line < endLine; line += blockSize) {
+			for (int along = startAlong; along < endAlong; along += blockSize) {
+				int column = columnMajor ? line : along;
+				int row = columnMajor ? along : line;
+				if (alreadyTraced(column, row)) {
+					continue;
+				}
+				Ray ray = cameraRays.PrimaryRay(column, row);
+
+				//Structure for storing the information we get from casting the ray
+				Payload payload;
+				payload.randomState = row * width + column;
+
+				//Default color is white
+				glm::vec3 color(1.0f);
+
+				//Cast our ray into the scene
+				float time;
+				IntersectInfo info;
+				if (costs == NULL) {
+					time = CastRayFor<Features>(scene, ray, payload, info, settings);
+				}
+				else {
+					long long tests = ThreadIntersectionTests();
+					chrono::steady_clock::time_point start = chrono::steady_clock::now();
+					time = CastRayFor<Features>(scene, ray, payload, info, settings);
+					PixelCost &cost = (*costs)[row * width + column];
+					cost.seconds = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+					cost.tests = (int)(ThreadIntersectionTests() - tests);
+					cost.bounces = payload.numBounces;
+				}
+				if (time > 0.0f) { // > 0.0f indicates an intersection
+					color = payload.color;
+				}
+				else {
+					info = IntersectInfo();
+				}
+				setPixel(column, row, color, info);
+			}
+		}
+	});
+}
+
+typedef void (*RenderTilesFunction)(const Scene &, const RenderSettings &, const TileSchedule &, int, bool, int, int,
+                                    vector<glm::vec3> &, ThreadPool &, vector<glm::uint> *, vector<IntersectInfo> *,
+                                    vector<PixelCost> *);
+static const RenderTilesFunction renderTilesFunctions[kNumFeatureMasks] = {
+	RenderTilesFor<0>, RenderTilesFor<1>, RenderTilesFor<2>, RenderTilesFor<3>,
+	RenderTilesFor<4>, RenderTilesFor<5>, RenderTilesFor<6>, RenderTilesFor<7>
+};
+
+void RenderTiles(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int blockSize, bool refine,
+                 int firstTile, int numTiles, vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels,
+                 vector<IntersectInfo> *primaryHits)
+{
+	RT_STAT_TIME(kRenderPhase);
+	TimelineScope timelineScope("Render pass", "block_size", blockSize);
+	// Pick the instantiation for the features that are on once for all the tiles
+	renderTilesFunctions[FeatureMask(settings)](scene, settings, schedule, blockSize, refine, firstTile, numTiles,
+	                                            framebuffer, threadPool, displayPixels, primaryHits, NULL);
+}
+
+// ShadeTiles for one feature mask
+template<int Features>
+static void ShadeTilesFor(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int firstTile, int numTiles,
+                          const vector<IntersectInfo> &primaryHits, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                          vector<glm::uint> *displayPixels)
+{
+	int width = schedule.Width();
+	int height = schedule.Height();
+	// The primary rays are only needed for their directions, which the shading and reflections use
+	CameraRays cameraRays(scene.camera, width, height);
+
+	threadPool.ParallelFor(numTiles, [&](int task) {
+		RT_STAT_TIME(kTracePhase);
+		TimelineScope timelineScope("Shade tile", "tile", firstTile + task);
+		const TileSchedule::Tile &tile = schedule[firstTile + task];
+
+		auto setPixel = [&](int column, int row, const glm::vec3 &color) {
+			framebuffer[row * width + column] = color;
+			if (displayPixels != NULL) {
+				(*displayPixels)[(height - 1 - row) * width + column] = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+			}
+		};
+
+		// Runs of up to kSimdWidth pixels that hit something along each row of the tile are shaded together, so
+		// that their shadow rays go as a packet
+		int packetSize = settings.packetTracing ? kSimdWidth : 1;
+		vector<Ray> rays;
+		int columns[kSimdWidth];
+		IntersectInfo infos[kSimdWidth];
+		bool hit[kSimdWidth];
+		Payload payloads[kSimdWidth];
+		float times[kSimdWidth];
+		for (int row = tile.startRow; row < tile.endRow; ++row) {
+			int count = 0;
+			for (int column = tile.startColumn; column < tile.endColumn; ++column) {
+				const IntersectInfo &primaryHit = primaryHits[row * width + column];
+				if (primaryHit.material == NULL) {
+					setPixel(column, row, glm::vec3(1.0f)); // Nothing was hit, so the pixel is the default white
+				}
+				else {
+					if (count == 0) {
+						rays.clear();
+					}
+					rays.push_back(cameraRays.PrimaryRay(column, row));
+					columns[count] = column;
+					infos[count] = primaryHit;
+					hit[count] = true;
+					payloads[count] = Payload();
+					payloads[count].randomState = row * width + column;
+					++count;
+				}
+				if (count == packetSize || (count > 0 && column + 1 == tile.endColumn)) {
+					if (settings.packetTracing) {
+						ShadeHitsFor<Features>(scene, &rays[0], count, infos, hit, payloads, times, settings);
+					}
+					else {
+						ShadeHitFor<Features>(scene, rays[0], infos[0], payloads[0], settings);
+					}
+					for (int lane = 0; lane < count; ++lane) {
+						setPixel(columns[lane], row, payloads[lane].color);
+					}
+					count = 0;
+				}
+			}
+		}
+	});
+}
+
+typedef void (*ShadeTilesFunction)(const Scene &, const RenderSettings &, const TileSchedule &, int, int,
+                                   const vector<IntersectInfo> &, vector<glm::vec3> &, ThreadPool &, vector<glm::uint> *);
+static const ShadeTilesFunction shadeTilesFunctions[kNumFeatureMasks] = {
+	ShadeTilesFor<0>, ShadeTilesFor<1>, ShadeTilesFor<2>, ShadeTilesFor<3>,
+	ShadeTilesFor<4>, ShadeTilesFor<5>, ShadeTilesFor<6>, ShadeTilesFor<7>
+};
+
+void ShadeTiles(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int firstTile, int numTiles,
+                const vector<IntersectInfo> &primaryHits, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                vector<glm::uint> *displayPixels)
+{
+	RT_STAT_TIME(kRenderPhase);
+	TimelineScope timelineScope("Shade pass");
+	shadeTilesFunctions[FeatureMask(settings)](scene, settings, schedule, firstTile, numTiles, primaryHits,
+	                                           framebuffer, threadPool, displayPixels);
+}
+
+void FindEdgePixels(const RenderSettings &settings, const TileSchedule &schedule, const vector<glm::vec3> &framebuffer,
+                    const vector<IntersectInfo> &primaryHits, ThreadPool &threadPool, vector<int> &edgePixels)
+{
+	TimelineScope timelineScope("Find edges");
+	int width = schedule.Width();
+	int height = schedule.Height();
+	// Each tile collects its own edges, so the list comes out in the order of the schedule whichever thread finishes first
+	vector<vector<int>> tileEdges(schedule.NumTiles());
+	threadPool.ParallelFor(schedule.NumTiles(), [&](int task) {
+		const TileSchedule::Tile &tile = schedule[task];
+		for (int row = tile.startRow; row < tile.endRow; ++row) {
+			for (int column = tile.startColumn; column < tile.endColumn; ++column) {
+				int pixel = row * width + column;
+				auto differs = [&](int other) {
+					glm::vec3 difference = glm::abs(framebuffer[pixel] - framebuffer[other]);
+					return primaryHits[pixel].material != primaryHits[other].material ||
+					       glm::max(difference.x, glm::max(difference.y, difference.z)) > settings.antialiasThreshold;
+				};
+				if ((column > 0 && differs(pixel - 1)) || (column + 1 < width && differs(pixel + 1)) ||
+				    (row > 0 && differs(pixel - width)) || (row + 1 < height && differs(pixel + width))) {
+					tileEdges[task].push_back(pixel);
+				}
+			}
+		}
+	});
+	edgePixels.clear();
+	for (size_t i = 0; i < tileEdges.size(); ++i) {
+		edgePixels.insert(edgePixels.end(), tileEdges[i].begin(), tileEdges[i].end());
+	}
+}
+
+// Trace several samples of one pixel, as packets if packet tracing is on
+//@rays The rays of the samples
+//@count The number of samples
+//@randomState The seed for the random numbers of the first sample, the others follow on from it
+//@colors Receives the colour of each sample
+template<int Features>
+static void TraceSamplesFor(const Scene &scene, const RenderSettings &settings, const Ray *rays, int count,
+                            unsigned int randomState, glm::vec3 *colors)
+{
+	// The samples of one pixel start out almost parallel, which suits packets well
+	Payload payloads[kSimdWidth];
+	float times[kSimdWidth];
+	IntersectInfo infos[kSimdWidth];
+	int packetSize = settings.packetTracing ? kSimdWidth : 1;
+	for (int first = 0; first < count; first += packetSize) {
+		int packetCount = glm::min(packetSize, count - first);
+		for (int lane = 0; lane < packetCount; ++lane) {
+			payloads[lane] = Payload();
+			payloads[lane].randomState = randomState + first + lane;
+		}
+		if (settings.packetTracing) {
+			CastRayPacketFor<Features>(scene, &rays[first], packetCount, payloads, times, infos, settings);
+		}
+		else {
+			times[0] = CastRayFor<Features>(scene, rays[first], payloads[0], infos[0], settings);
+		}
+		for (int lane = 0; lane < packetCount; ++lane) {
+			//Default color is white, time > 0.0f indicates an intersection
+			colors[first + lane] = times[lane] > 0.0f ? payloads[lane].color : glm::vec3(1.0f);
+		}
+	}
+}
+
+// AntialiasPixels for one feature mask
+template<int Features>
+static void AntialiasPixelsFor(const Scene &scene, const RenderSettings &settings, int width, int height, const vector<int> &edgePixels,
+                               int firstPixel, int numPixels, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                               vector<glm::uint> *displayPixels)
+{
+	CameraRays cameraRays(scene.camera, width, height);
+	int grid = settings.antialiasGrid;
+	int numSamples = grid * grid;
+	// Give each task about as many rays as a tile of single samples
+	int pixelsPerTask = glm::max(1, tileSize * tileSize / numSamples);
+	int numTasks = (numPixels + pixelsPerTask - 1) / pixelsPerTask;
+
+	threadPool.ParallelFor(numTasks, [&](int task) {
+		RT_STAT_TIME(kTracePhase);
+		TimelineScope timelineScope("Antialias", "task", task);
+		int start = firstPixel + task * pixelsPerTask;
+		int end = glm::min(start + pixelsPerTask, firstPixel + numPixels);
+		vector<Ray> rays;
+		rays.reserve(numSamples);
+		vector<glm::vec3> colors(numSamples);
+		for (int i = start; i < end; ++i) {
+			int pixel = edgePixels[i];
+			int column = pixel % width;
+			int row = pixel / width;
+			RT_STAT_ADD(kEdgePixels, 1);
+
+			// One ray through a random point of each cell of the grid. The random numbers are seeded by the pixel so
+			// that renders are repeatable
+			unsigned int randomState = pixel;
+			rays.clear();
+			for (int cellRow = 0; cellRow < grid; ++cellRow) {
+				for (int cellColumn = 0; cellColumn < grid; ++cellColumn) {
+					float x = column + (cellColumn + NextRandom(randomState)) / grid;
+					float y = row + (cellRow + NextRandom(randomState)) / grid;
+					rays.push_back(cameraRays.RayThrough(x, y));
+				}
+			}
+
+			TraceSamplesFor<Features>(scene, settings, &rays[0], numSamples, pixel * numSamples, &colors[0]);
+			glm::vec3 sum(0.0f);
+			for (int sample = 0; sample < numSamples; ++sample) {
+				sum += colors[sample];
+			}
+			glm::vec3 color = sum / (float)numSamples;
+			framebuffer[pixel] = color;
+			if (displayPixels != NULL) {
+				(*displayPixels)[(height - 1 - row) * width + column] = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+			}
+		}
+	});
+}
+
+typedef void (*AntialiasPixelsFunction)(const Scene &, const RenderSettings &, int, int, const vector<int> &, int, int,
+                                        vector<glm::vec3> &, ThreadPool &, vector<glm::uint> *);
+static const AntialiasPixelsFunction antialiasPixelsFunctions[kNumFeatureMasks] = {
+	AntialiasPixelsFor<0>, AntialiasPixelsFor<1>, AntialiasPixelsFor<2>, AntialiasPixelsFor<3>,
+	AntialiasPixelsFor<4>, AntialiasPixelsFor<5>, AntialiasPixelsFor<6>, AntialiasPixelsFor<7>
+};
+
+void AntialiasPixels(const Scene &scene, const RenderSettings &settings, int width, int height, const vector<int> &edgePixels,
+                     int firstPixel, int numPixels, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                     vector<glm::uint> *displayPixels)
+{
+	TimelineScope timelineScope("Antialias pass", "pixels", numPixels);
+	antialiasPixelsFunctions[FeatureMask(settings)](scene, settings, width, height, edgePixels, firstPixel, numPixels,
+	                                                framebuffer, threadPool, displayPixels);
+}
+
+//The running mean and variance of the samples of one pixel
+//The variance is of the brightness of the samples, updated one sample at a time with Welford's method, which does not
+//lose precision the way subtracting the square of the mean from the mean of the squares does
+struct PixelEstimate
+{
+	PixelEstimate():
+		sum(0.0f),
+		mean(0.0f),
+		squaredDeviations(0.0f),
+		count(0)
+	{
+	}
+
+	//Add the colour of a sample
+	void Add(const glm::vec3 &color)
+	{
+		sum += color;
+		++count;
+		float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		float delta = luminance - mean;
+		mean += delta / count;
+		squaredDeviations += delta * (luminance - mean);
+	}
+
+	//Returns the standard error of the mean brightness, i.e. how far it is likely to be from the brightness that
+	//infinitely many samples would give
+	float Error() const
+	{
+		return count > 1 ? sqrt(squaredDeviations / (count - 1) / count) : std::numeric_limits<float>::infinity();
+	}
+
+	glm::vec3 sum; // The colours of the samples added up
+	float mean; // The mean brightness of the samples
+	float squaredDeviations; // The squared differences of the brightnesses from their mean, added up
+	int count; // The number of samples
+};
+
+// The adaptive sampling version of RenderImage for one feature mask
+// Sampling goes in rounds. The first gives every pixel minSamples samples, then each round gives one more packet of
+// samples to every pixel whose error is still above the noise threshold, and to the pixels next to it. A few samples
+// can all miss a thin sliver of another object in a pixel and make it look converged, but then the pixel next to it
+// on the other side of the edge will not be. A tile with no pixels left to sample drops out, and the tiles still
+// going are sorted noisiest first, so the threads start on them and the ones that run out of work steal from the
+// front of the others' queues, i.e. the noisiest tiles that have not been started
+template<int Features>
+static void RenderAdaptiveFor(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule,
+                              vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels)
+{
+	int width = schedule.Width();
+	int height = schedule.Height();
+	CameraRays cameraRays(scene.camera, width, height);
+	int maxSamples = settings.maxSamples;
+	int minSamples = glm::clamp(settings.minSamples, 2, maxSamples);
+	vector<PixelEstimate> estimates(width * height);
+	vector<unsigned char> wanted(width * height, 1); // The pixels to sample in the next round
+	vector<float> tileErrors(schedule.NumTiles()); // The largest error of a pixel to sample, 0 for none
+	vector<int> activeTiles(schedule.NumTiles());
+	for (int i = 0; i < schedule.NumTiles(); ++i) {
+		activeTiles[i] = i;
+	}
+
+	auto converged = [&](int pixel) {
+		const PixelEstimate &estimate = estimates[pixel];
+		return estimate.count >= minSamples && estimate.Error() <= settings.noiseThreshold;
+	};
+
+	for (int round = 0; !activeTiles.empty(); ++round) {
+		{
+			TimelineScope timelineScope("Sampling round", "round", round);
+			threadPool.ParallelFor((int)activeTiles.size(), [&](int task) {
+				RT_STAT_TIME(kTracePhase);
+				TimelineScope timelineScope("Tile", "tile", activeTiles[task]);
+				const TileSchedule::Tile &tile = schedule[activeTiles[task]];
+				vector<Ray> rays;
+				vector<glm::vec3> colors;
+				for (int row = tile.startRow; row < tile.endRow; ++row) {
+					for (int column = tile.startColumn; column < tile.endColumn; ++column) {
+						int pixel = row * width + column;
+						if (!wanted[pixel]) {
+							continue;
+						}
+						PixelEstimate &estimate = estimates[pixel];
+
+						// The sample points follow the R2 sequence, which spreads any number of samples evenly over
+						// the pixel, offset by a random amount for each pixel so that neighbours do not share a pattern
+						unsigned int randomState = pixel;
+						float offsetX = NextRandom(randomState);
+						float offsetY = NextRandom(randomState);
+						int count = estimate.count == 0 ? minSamples : glm::min(kSimdWidth, maxSamples - estimate.count);
+						rays.clear();
+						for (int sample = estimate.count; sample < estimate.count + count; ++sample) {
+							float x = offsetX + sample * 0.7548776662f;
+							float y = offsetY + sample * 0.5698402910f;
+							rays.push_back(cameraRays.RayThrough(column + x - floor(x), row + y - floor(y)));
+						}
+						colors.resize(count);
+						TraceSamplesFor<Features>(scene, settings, &rays[0], count, pixel * maxSamples + estimate.count, &colors[0]);
+						for (int sample = 0; sample < count; ++sample) {
+							estimate.Add(colors[sample]);
+						}
+
+						glm::vec3 color = estimate.sum / (float)estimate.count;
+						framebuffer[pixel] = color;
+						if (displayPixels != NULL) {
+							(*displayPixels)[(height - 1 - row) * width + column] = glm::packUnorm4x8(glm::vec4(color, 1.0f));
+						}
+					}
+				}
+			});
+		}
+
+		// Pick the pixels for the next round now that no pixel is changing, as each one looks at its neighbours
+		threadPool.ParallelFor((int)activeTiles.size(), [&](int task) {
+			const TileSchedule::Tile &tile = schedule[activeTiles[task]];
+			float worstError = 0.0f;
+			for (int row = tile.startRow; row < tile.endRow; ++row) {
+				for (int column = tile.startColumn; column < tile.endColumn; ++column) {
+					int pixel = row * width + column;
+					bool more = estimates[pixel].count < maxSamples &&
+					            (!converged(pixel) || (column > 0 && !converged(pixel - 1)) ||
+					             (column + 1 < width && !converged(pixel + 1)) || (row > 0 && !converged(pixel - width)) ||
+					             (row + 1 < height && !converged(pixel + width)));
+					wanted[pixel] = more;
+					if (more) {
+						// Above 0 even if it is only here for a neighbour
+						worstError = glm::max(worstError, glm::max(estimates[pixel].Error(), std::numeric_limits<float>::min()));
+					}
+				}
+			}
+			tileErrors[activeTiles[task]] = worstError;
+		});
+
+		// Carry on with the tiles that still have pixels to sample, noisiest first
+		vector<int> stillActive;
+		for (size_t i = 0; i < activeTiles.size(); ++i) {
+			if (tileErrors[activeTiles[i]] > 0.0f) {
+				stillActive.push_back(activeTiles[i]);
+			}
+		}
+		sort(stillActive.begin(), stillActive.end(), [&](int a, int b) {
+			return tileErrors[a] > tileErrors[b];
+		});
+		activeTiles.swap(stillActive);
+	}
+}
+
+typedef void (*RenderAdaptiveFunction)(const Scene &, const RenderSettings &, const TileSchedule &, vector<glm::vec3> &,
+                                       ThreadPool &, vector<glm::uint> *);
+static const RenderAdaptiveFunction renderAdaptiveFunctions[kNumFeatureMasks] = {
+	RenderAdaptiveFor<0>, RenderAdaptiveFor<1>, RenderAdaptiveFor<2>, RenderAdaptiveFor<3>,
+	RenderAdaptiveFor<4>, RenderAdaptiveFor<5>, RenderAdaptiveFor<6>, RenderAdaptiveFor<7>
+};
+
+void RenderImage(const Scene &scene, const RenderSettings &settings, int width, int height,
+                 vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels,
+                 vector<PixelCost> *costs)
+{
+	RT_STAT_TIME(kRenderPhase);
+	TimelineScope timelineScope("Render image");
+	framebuffer.assign(width * height, glm::vec3(1.0f));
+	if (displayPixels != NULL) {
+		displayPixels->assign(width * height, glm::packUnorm4x8(glm::vec4(1.0f)));
+	}
+	if (costs != NULL) {
+		costs->assign(width * height, PixelCost());
+	}
+	TileSchedule schedule(width, height, settings.pixelOrder);
+	if (settings.maxSamples > 1 && costs == NULL) {
+		renderAdaptiveFunctions[FeatureMask(settings)](scene, settings, schedule, framebuffer, threadPool, displayPixels);
+		return;
+	}
+	bool antialias = settings.antialiasGrid > 1 && costs == NULL;
+	vector<IntersectInfo> primaryHits;
+	if (antialias) {
+		primaryHits.resize(width * height);
+	}
+	renderTilesFunctions[FeatureMask(settings)](scene, settings, schedule, 1, false, 0, schedule.NumTiles(),
+	                                            framebuffer, threadPool, displayPixels, antialias ? &primaryHits : NULL, costs);
+	if (antialias) {
+		vector<int> edgePixels;
+		FindEdgePixels(settings, schedule, framebuffer, primaryHits, threadPool, edgePixels);
+		AntialiasPixels(scene, settings, width, height, edgePixels, 0, (int)edgePixels.size(), framebuffer, threadPool, displayPixels);
+	}
+}
+
+float CostHeatmap(const vector<PixelCost> &costs, CostMetric metric, vector<glm::vec3> &image)
+{
+	vector<float> values(costs.size());
+	for (size_t i = 0; i < costs.size(); ++i) {
+		switch (metric) {
+		case kTimeCost :
+			values[i] = costs[i].seconds;
+			break;
+		case kTestsCost :
+			values[i] = (float)costs[i].tests;
+			break;
+		default :
+			values[i] = (float)costs[i].bounces;
+			break;
+		}
+	}
+
+	float fullScale = 0.0f;
+	if (!values.empty()) {
+		vector<float> sorted = values;
+		vector<float>::iterator percentile = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+		nth_element(sorted.begin(), percentile, sorted.end());
+		fullScale = *percentile;
+	}
+
+	// Evenly spaced stops along the colour scale
+	static const glm::vec3 scale[] = {
+		glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)
+	};
+	const int numSteps = sizeof(scale) / sizeof(scale[0]) - 1;
+	image.resize(values.size());
+	for (size_t i = 0; i < values.size(); ++i) {
+		float position = fullScale > 0.0f ? glm::min(values[i] / fullScale, 1.0f) * numSteps : 0.0f;
+		int step = glm::min((int)position, numSteps - 1);
+		image[i] = glm::mix(scale[step], scale[step + 1], position - step);
+	}
+	return fullScale;
+}
+
+ProgressiveRender::ProgressiveRender():
+	_width(0),
+	_height(0),
+	_blockSize(0),
+	_nextTile(0),
+	_primaryHitsValid(false),
+	_relighting(false),
+	_antialiasing(false)
+{
+}
+
+void ProgressiveRender::Restart(int width, int height)
+{
+	// Keep showing the old frame until the first pass has drawn over it
+	if (width != _width || height != _height) {
+		_width = width;
+		_height = height;
+		framebuffer.assign(width * height, glm::vec3(1.0f));
+		displayPixels.assign(width * height, glm::packUnorm4x8(glm::vec4(1.0f)));
+		_primaryHits.resize(width * height);
+	}
+	_blockSize = kProgressiveBlockSize;
+	_nextTile = 0;
+	_primaryHitsValid = false;
+	_relighting = false;
+	_antialiasing = false;
+}
+
+void ProgressiveRender::Relight()
+{
+	if (!_primaryHitsValid) {
+		Restart(_width, _height);
+		return;
+	}
+	_blockSize = 0;
+	_nextTile = 0;
+	_relighting = true;
+	_antialiasing = false;
+}
+
+void ProgressiveRender::StartAntialiasing(const RenderSettings &settings, ThreadPool &threadPool)
+{
+	if (settings.antialiasGrid > 1) {
+		RT_STAT_TIME(kRenderPhase);
+		FindEdgePixels(settings, _schedule, framebuffer, _primaryHits, threadPool, _edgePixels);
+		_antialiasing = !_edgePixels.empty();
+	}
+}
+
+bool ProgressiveRender::Step(const Scene &scene, const RenderSettings &settings, ThreadPool &threadPool, int maxTiles)
+{
+	if (Finished()) {
+		return true;
+	}
+	// The tile order is taken from the settings when the frame starts and kept for all its passes
+	if (_blockSize == kProgressiveBlockSize && _nextTile == 0) {
+		_schedule = TileSchedule(_width, _height, settings.pixelOrder);
+	}
+	if (_antialiasing) {
+		RT_STAT_TIME(kRenderPhase);
+		// About as many rays as maxTiles tiles of single samples
+		int numSamples = settings.antialiasGrid * settings.antialiasGrid;
+		int numPixels = glm::min(glm::max(1, maxTiles * tileSize * tileSize / numSamples), (int)_edgePixels.size() - _nextTile);
+		AntialiasPixels(scene, settings, _width, _height, _edgePixels, _nextTile, numPixels, framebuffer, threadPool, &displayPixels);
+		_nextTile += numPixels;
+		_antialiasing = _nextTile < (int)_edgePixels.size();
+		return Finished();
+	}
+
+	int numTiles = glm::min(maxTiles, _schedule.NumTiles() - _nextTile);
+	if (_relighting) {
+		ShadeTiles(scene, settings, _schedule, _nextTile, numTiles, _primaryHits, framebuffer, threadPool, &displayPixels);
+		_nextTile += numTiles;
+		if (_nextTile == _schedule.NumTiles()) {
+			_relighting = false;
+			_nextTile = 0;
+			StartAntialiasing(settings, threadPool);
+		}
+		return Finished();
+	}
+
+	RenderTiles(scene, settings, _schedule, _blockSize, _blockSize < kProgressiveBlockSize,
+	            _nextTile, numTiles, framebuffer, threadPool, &displayPixels, &_primaryHits);
+	_nextTile += numTiles;
+
+	// Move on to the next pass, which halves the block size
+	if (_nextTile == _schedule.NumTiles()) {
+		_blockSize /= 2;
+		_nextTile = 0;
+		// Once every pixel has been traced, the primary hits are all in and the edges can be found
+		if (_blockSize == 0) {
+			_primaryHitsValid = true;
+			StartAntialiasing(settings, threadPool);
+		}
+	}
+	return Finished();
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "Scene.h"
+#include "ThreadPool.h"
+
+//How the image is split into tiles, one task for the thread pool each, and the order its pixels are traced in
+//The thread pool starts each thread on a run of consecutive tiles, so along the Morton and Hilbert curves each
+//thread works on a compact patch of the image, and neighbouring rays touch the same BVH nodes and primitives
+enum PixelOrder
+{
+	kColumnMajorOrder, // Strips of whole columns, traced column by column (how the image was first rendered)
+	kRowMajorOrder, // Strips of whole rows, traced row by row
+	kTiledOrder, // Square tiles taken row by row, each traced row by row
+	kMortonOrder, // Square tiles along a Morton (Z-order) curve, each traced row by row
+	kHilbertOrder, // Square tiles along a Hilbert curve, each traced row by row
+	kNumPixelOrders
+};
+
+//Returns the name of a pixel order, as given on the command line: column, row, tiled, morton or hilbert
+const char *PixelOrderName(PixelOrder order);
+
+//The render options from the control panel
+//These are filled in before a frame is rendered and are only read while the render threads are running
+//The three activate switches are looked at once per frame, to pick a version of the tracer built for just those features
+struct RenderSettings
+{
+	RenderSettings():
+		activateShadows(true),
+		activatePhong(true),
+		activateReflections(true),
+		maxReflections(5),
+		minThroughput(1.0f / 256.0f),
+		russianRoulette(false),
+		packetTracing(true),
+		pixelOrder(kHilbertOrder),
+		antialiasGrid(1),
+		antialiasThreshold(0.1f),
+		maxSamples(1),
+		minSamples(8),
+		noiseThreshold(1.0f / 256.0f)
+	{
+	}
+
+	bool activateShadows; // Send shadow rays and generate basic shadows
+	bool activatePhong; // Local phong illumination
+	bool activateReflections; // Generate and compute reflection rays
+	int maxReflections; // The maximum number of bounces for reflection rays
+	float minThroughput; // Reflections are ended once they can add less than this to a pixel, 0 to always go to maxReflections
+	bool russianRoulette; // Instead of ending them, continue the reflections below minThroughput at random, which avoids darkening the image
+	bool packetTracing; // Trace the primary rays of neighbouring pixels together using SIMD
+	PixelOrder pixelOrder; // How the image is split into tiles and the order they are traced in
+	int antialiasGrid; // Pixels on an edge are traced again with this many by this many samples, 1 for no anti-aliasing
+	float antialiasThreshold; // Neighbouring pixels whose colours differ by more than this in any channel are on an edge
+	int maxSamples; // Above 1, RenderImage samples every pixel until it converges or has this many samples (see RenderImage)
+	int minSamples; // The samples every pixel gets before it can be judged converged, at least 2
+	float noiseThreshold; // A pixel has converged once the standard error of its mean brightness is below this
+};
+
+//What it cost to trace one pixel, recorded by RenderImage for the heatmap debug view (see CostHeatmap)
+struct PixelCost
+{
+	PixelCost():
+		seconds(0.0f),
+		tests(0),
+		bounces(0)
+	{
+	}
+
+	float seconds; // The time taken to trace the pixel, including its shadow rays and reflections
+	int tests; // Intersection tests of the pixel's rays against BVH nodes and primitives. Only counted in a build with RT_STATS
+	int bounces; // Payload::numBounces of the pixel's path
+};
+
+//The costs that a heatmap can show
+enum CostMetric
+{
+	kTimeCost,
+	kTestsCost,
+	kBouncesCost,
+	kNumCostMetrics
+};
+
+//Ray-casting function
+//Called for each pixel. Reflections are followed in a loop, so deep maxReflections values do not use up the stack
+//@scene The scene to cast the ray into
+//@ray The ray we are casting
+//@payload Information on the current ray i.e. the cumulative color and the number of bounces it has performed
+//@settings The control panel settings for this frame
+//Safe to call from several threads at once as it only reads the scene and the settings
+//returns either the time of intersection with an object (the coefficient t in the equation: RayPosition = RayOrigin + t*RayDirection) or zero to indicate no intersection
+float CastRay(const Scene &scene, const Ray &ray, Payload &payload, const RenderSettings &settings);
+
+//Cast a packet of primary rays into the scene
+//Gives the same result as calling CastRay for each ray, but the closest hits and the shadow rays of all
+//the rays are traced together with SIMD instructions. Shading and reflections are still done one ray at a time
+//@scene The scene to cast the rays into
+//@rays The rays we are casting
+//@count The number of rays, at most kSimdWidth
+//@payloads Per ray, information on the ray i.e. the cumulative color and the number of bounces it has performed
+//@times Per ray, set to the time of the intersection with an object or zero to indicate no intersection
+//@settings The control panel settings for this frame
+void CastRayPacket(const Scene &scene, const Ray *rays, int count, Payload *payloads, float *times, const RenderSettings &settings);
+
+//The tiles an image is split into for rendering, in the order they are traced (see PixelOrder)
+class TileSchedule
+{
+public:
+	//The pixels of one tile, from the start column and row up to but not including the end ones
+	struct Tile
+	{
+		int startColumn;
+		int startRow;
+		int endColumn;
+		int endRow;
+	};
+
+	TileSchedule();
+
+	//@width, height The resolution of the image
+	//@order How to split the image into tiles and order them
+	TileSchedule(int width, int height, PixelOrder order);
+
+	int Width() const { return _width; }
+	int Height() const { return _height; }
+	PixelOrder Order() const { return _order; }
+
+	//Returns true if the pixels of each tile are traced column by column rather than row by row
+	bool ColumnMajor() const { return _order == kColumnMajorOrder; }
+
+	int NumTiles() const { return (int)_tiles.size(); }
+	const Tile &operator [](int i) const { return _tiles[i]; }
+
+private:
+	int _width;
+	int _height;
+	PixelOrder _order;
+	vector<Tile> _tiles;
+};
+
+//Render some of the tiles of an image
+//The tiles are traced in parallel on the thread pool. With a block size above 1 only one ray is traced for each
+//square block of pixels, at its top left corner, and its colour fills the whole block
+//@scene The scene to render
+//@settings The control panel settings for this frame
+//@schedule The tiles of the image, which also give its resolution
+//@blockSize The width and height of the blocks, a power of two no bigger than 16
+//@refine True if the pass with twice this block size has already been rendered, whose pixels are then not traced again
+//@firstTile, numTiles The range of tiles to render, in the order of the schedule
+//@framebuffer Receives the colour of every pixel rendered, row by row starting from the top left. Must already be the right size
+//@threadPool The threads to render with
+//@displayPixels If not NULL, also receives every pixel rendered packed as 8-bit RGBA (see glm::packUnorm4x8), row by
+//               row starting from the bottom left so that it can be passed straight to glDrawPixels. Must already be the right size
+//@primaryHits If not NULL, receives the first hit of the primary ray of every pixel rendered, in the same order as the
+//             framebuffer, with a NULL material where nothing was hit. Must already be the right size
+void RenderTiles(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int blockSize, bool refine,
+                 int firstTile, int numTiles, vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels,
+                 vector<IntersectInfo> *primaryHits = NULL);
+
+//Shade some of the tiles of an image again from the primary hits of an earlier render, e.g. after the light has moved
+//The primary hits only depend on the camera and the geometry, so only the shadow rays and reflections are traced and
+//the result is the same as rendering the tiles again
+//@scene The scene to shade, whose camera and geometry must not have changed since the primary hits were found
+//@settings The control panel settings for this frame
+//@schedule The tiles of the image, which also give its resolution
+//@firstTile, numTiles The range of tiles to shade, in the order of the schedule
+//@primaryHits The first hit of every pixel, from RenderTiles
+//@framebuffer Receives the colour of every pixel shaded
+//@threadPool The threads to shade with
+//@displayPixels If not NULL, also receives the colours packed as 8-bit RGBA, bottom row first (see RenderTiles)
+void ShadeTiles(const Scene &scene, const RenderSettings &settings, const TileSchedule &schedule, int firstTile, int numTiles,
+                const vector<IntersectInfo> &primaryHits, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                vector<glm::uint> *displayPixels);
+
+//Find the pixels of a rendered image that lie on an edge, which are the only ones worth anti-aliasing
+//A pixel is on an edge if it hit a different material from one of the four pixels next to it, which finds the
+//outlines of objects, or if their colours differ by more than RenderSettings::antialiasThreshold, which also finds
+//shadow edges and the edges of reflections
+//@settings The control panel settings the image was rendered with
+//@schedule The tiles of the image, which also give its resolution
+//@framebuffer The colour of every pixel, from RenderTiles
+//@primaryHits The first hit of every pixel, from RenderTiles
+//@threadPool The threads to search with
+//@edgePixels Receives the index in the framebuffer of every pixel on an edge, tile by tile in the order of the schedule
+void FindEdgePixels(const RenderSettings &settings, const TileSchedule &schedule, const vector<glm::vec3> &framebuffer,
+                    const vector<IntersectInfo> &primaryHits, ThreadPool &threadPool, vector<int> &edgePixels);
+
+//Trace some of the pixels on the edges of an image again with several samples each and replace their colours
+//with the average. Each pixel is split into a grid of RenderSettings::antialiasGrid by antialiasGrid cells and one
+//ray is traced through a random point of each cell, so the samples are spread evenly over the pixel
+//@scene The scene to render
+//@settings The control panel settings for this frame
+//@width, height The resolution of the image
+//@edgePixels The pixels to anti-alias, from FindEdgePixels
+//@firstPixel, numPixels The range of edgePixels to anti-alias
+//@framebuffer Receives the new colour of every pixel anti-aliased
+//@threadPool The threads to render with
+//@displayPixels If not NULL, also receives the new colours packed as 8-bit RGBA, bottom row first (see RenderTiles)
+void AntialiasPixels(const Scene &scene, const RenderSettings &settings, int width, int height, const vector<int> &edgePixels,
+                     int firstPixel, int numPixels, vector<glm::vec3> &framebuffer, ThreadPool &threadPool,
+                     vector<glm::uint> *displayPixels);
+
+//Render a frame of the scene
+//The image is split into tiles (see RenderSettings::pixelOrder) which are traced in parallel on the thread pool. With
+//anti-aliasing on (see RenderSettings::antialiasGrid), the pixels on edges are then traced again with more samples
+//With RenderSettings::maxSamples above 1 the pixels are sampled adaptively instead: every pixel gets minSamples
+//samples spread over its area, then the pixels whose mean is still uncertain get more, a packet at a time, until
+//the standard error of their brightness is below noiseThreshold or they reach maxSamples. Flat areas stop early and
+//the samples go to edges, shadow boundaries and noisy reflections. antialiasGrid is not used as the samples already
+//cover each pixel
+//@scene The scene to render
+//@settings The control panel settings for this frame
+//@width, height The resolution of the image
+//@framebuffer Receives the colour of every pixel, row by row starting from the top left
+//@threadPool The threads to render with
+//@displayPixels If not NULL, also receives every pixel packed as 8-bit RGBA (see glm::packUnorm4x8), row by row
+//               starting from the bottom left so that it can be passed straight to glDrawPixels
+//@costs If not NULL, also receives what each pixel cost to trace, in the same order as the framebuffer. The pixels
+//       are then traced one at a time rather than in packets so that each one is measured on its own, and are
+//       not anti-aliased
+void RenderImage(const Scene &scene, const RenderSettings &settings, int width, int height,
+                 vector<glm::vec3> &framebuffer, ThreadPool &threadPool, vector<glm::uint> *displayPixels = NULL,
+                 vector<PixelCost> *costs = NULL);
+
+//Turn the costs of the pixels into a false-colour image, running from black for the cheapest through blue, green
+//and yellow to red for the most expensive
+//@costs The cost of each pixel, from RenderImage
+//@metric Which of the costs to show
+//@image Receives the colour of every pixel
+//returns the cost shown as full red. This is the 99th percentile rather than the maximum so that a few outliers,
+//e.g. pixels whose thread was interrupted, do not squash the rest of the scale. Dearer pixels are red too
+float CostHeatmap(const vector<PixelCost> &costs, CostMetric metric, vector<glm::vec3> &image);
+
+//The block size of the first, coarsest pass of a progressive render
+static const int kProgressiveBlockSize = 8;
+
+//Renders a frame a little at a time so that a window can stay responsive while it is traced
+//The first pass traces one ray per 8x8 block of pixels, which gives a rough picture almost at once, then each
+//pass halves the block size until every pixel has been traced. Pixels traced by a coarser pass are not traced
+//again, so the whole frame costs no more than rendering it in one go. With anti-aliasing on, a last pass then
+//smooths the edges
+class ProgressiveRender
+{
+public:
+	ProgressiveRender();
+
+	//Throw away any work in progress and start again from the coarsest pass, e.g. after the view has changed
+	//@width, height The resolution of the image
+	void Restart(int width, int height);
+
+	//Render the frame again after only the light has moved
+	//The primary hit of every pixel is kept from the last frame, so the pixels are just shaded again at full
+	//resolution (see ShadeTiles) without tracing any primary rays. If the last frame had not traced every pixel yet,
+	//this restarts it instead. The camera and the geometry must not have changed, or Restart must be used
+	void Relight();
+
+	//Render the next few tiles of the current pass
+	//@scene The scene to render
+	//@settings The control panel settings for this frame
+	//@threadPool The threads to render with
+	//@maxTiles The most tiles to render before returning
+	//returns true once the frame is finished
+	bool Step(const Scene &scene, const RenderSettings &settings, ThreadPool &threadPool, int maxTiles);
+
+	//Returns true once every pixel has been traced, and anti-aliased if that is on
+	bool Finished() const { return _blockSize == 0 && !_relighting && !_antialiasing; }
+
+	//Returns the block size of the pass in progress, 0 while relighting or anti-aliasing
+	int BlockSize() const { return _blockSize; }
+
+	vector<glm::vec3> framebuffer; // The colour of every pixel, row by row starting from the top left
+	vector<glm::uint> displayPixels; // The same packed as 8-bit RGBA, bottom row first, for glDrawPixels
+
+private:
+	//Find the edges of the finished frame and start the anti-aliasing pass, if anti-aliasing is on
+	void StartAntialiasing(const RenderSettings &settings, ThreadPool &threadPool);
+
+	int _width;
+	int _height;
+	int _blockSize; // Block size of the pass in progress, 0 when finished
+	int _nextTile; // The next tile to render in the current pass, or the next edge pixel in the anti-aliasing pass
+	TileSchedule _schedule; // The tiles of the frame, set up when its first pass starts
+	vector<IntersectInfo> _primaryHits; // The first hit of each pixel, for relighting and finding edges
+	bool _primaryHitsValid; // Set once every pixel of the frame has been traced
+	bool _relighting; // Set while the pixels are being shaded again from the primary hits
+	bool _antialiasing; // Set during the anti-aliasing pass
+	vector<int> _edgePixels; // The pixels the anti-aliasing pass traces again
+};
@@ -0,0 +1,289 @@
+#include "Scene.h"
+#include "MappedFile.h"
+
+Scene::Scene():
+	lightPos(0.0f, 50.0f, 125.0f),
+	_finalized(false)
+{
+	camera.SetPosition(glm::vec3(0.0f, 0.0f, 200.0f));
+}
+
+Scene::~Scene()
+{
+}
+
+void Scene::Add(Object *object)
+{
+	if (_finalized) {
+		cerr << "Objects cannot be added to a scene after it has been finalised" << endl;
+		delete object;
+		return;
+	}
+	_objects.push_back(unique_ptr<Object>(object));
+}
+
+void Scene::Finalize()
+{
+	for (auto obj = _objects.begin(); obj != _objects.end(); ++obj) {
+		(*obj)->Compile(_primitives);
+	}
+	_objects.clear();
+	_bvh.Build(_primitives);
+	_finalized = true;
+}
+
+bool Scene::FinalizeMapped(unique_ptr<MappedFile> mapping)
+{
+	_objects.clear();
+	_mapping = std::move(mapping);
+	if (!_primitives.Validate()) {
+		return false;
+	}
+	if (_bvh.Empty()) {
+		_bvh.Build(_primitives);
+	}
+	else if (_bvh.Validate(_primitives)) {
+		_bvh.Attach(_primitives);
+	}
+	else {
+		return false;
+	}
+	_finalized = true;
+	return true;
+}
+
+bool Scene::Intersect(const Ray &ray, IntersectInfo &info) const
+{
+	// Planes can be anywhere so each one has to be tested, then the BVH only reports hits closer than those
+	PrimitiveHit hit;
+	bool found = _primitives.Intersect(kPlane, ray, 0, _primitives.Count(kPlane), hit);
+	if (_bvh.Intersect(ray, hit)) {
+		found = true;
+	}
+	if (found) {
+		_primitives.IntersectInfoFor(ray, hit, info);
+	}
+	return found;
+}
+
+bool Scene::Occluded(const Ray &ray, float tMax) const
+{
+	return _primitives.Occluded(kPlane, ray, 0, _primitives.Count(kPlane), tMax) || _bvh.Occluded(ray, tMax);
+}
+
+SimdMask Scene::IntersectPacket(const RayPacket &packet, SimdFloat &time, PrimitiveHit hits[]) const
+{
+	SimdMask found = _primitives.IntersectPacket(kPlane, packet, 0, _primitives.Count(kPlane), time, hits);
+	return found | _bvh.IntersectPacket(packet, time, hits);
+}
+
+SimdMask Scene::OccludedPacket(const RayPacket &packet, const SimdFloat &tMax) const
+{
+	SimdMask blocked = _primitives.OccludedPacket(kPlane, packet, 0, _primitives.Count(kPlane), tMax);
+	// Only the rays that are not already blocked need to go through the BVH
+	return blocked | _bvh.OccludedPacket(packet, Select(blocked, SimdFloat(0.0f), tMax));
+}
+
+unique_ptr<Scene> LoadDemoScene(int number)
+{
+	unique_ptr<Scene> scene(new Scene());
+
+	// Set up the materials used in the scene
+	Material white = Material();
+		white.ambient = glm::vec3(1, 1, 1);
+		white.diffuse = glm::vec3(1, 1, 1);
+		white.specular = glm::vec3(1, 1, 1);
+		white.specularExponent = 10;
+		white.Klocal = 0.9;
+		white.Kreflectivity = 0.1;
+
+	Material whiteAbsorb = Material();
+		whiteAbsorb.ambient = glm::vec3(1, 1, 1);
+		whiteAbsorb.diffuse = glm::vec3(1, 1, 1);
+		whiteAbsorb.specular = glm::vec3(1, 1, 1);
+		whiteAbsorb.specularExponent = 1;
+		whiteAbsorb.Klocal = 1.0;
+		whiteAbsorb.Kreflectivity = 0;
+
+	Material shinyGreen = Material();
+		shinyGreen.ambient = glm::vec3(0, 1, 0);
+		shinyGreen.diffuse = glm::vec3(0, 1, 0);
+		shinyGreen.specular = glm::vec3(1, 1, 1);
+		shinyGreen.specularExponent = 50;
+		shinyGreen.Klocal = 0.8;
+		shinyGreen.Kreflectivity = 0.2;
+
+	Material red = Material();
+		red.ambient = glm::vec3(1, 0, 0);
+		red.diffuse = glm::vec3(1, 0, 0);
+		red.specular = glm::vec3(1, 1, 1);
+		red.specularExponent = 10;
+		red.Klocal = 0.9;
+		red.Kreflectivity = 0.1;
+
+	Material blue = Material();
+		blue.ambient = glm::vec3(0, 0, 1);
+		blue.diffuse = glm::vec3(0, 0, 1);
+		blue.specular = glm::vec3(1, 1, 1);
+		blue.specularExponent = 10;
+		blue.Klocal = 0.9;
+		blue.Kreflectivity = 0.1;
+
+	Material yellow = Material();
+		yellow.ambient = glm::vec3(1, 1, 0);
+		yellow.diffuse = glm::vec3(1, 1, 0);
+		yellow.specular = glm::vec3(1, 1, 1);
+		yellow.specularExponent = 50;
+		yellow.Klocal = 1;
+		yellow.Kreflectivity = 0;
+
+	Material mirror = Material();
+		mirror.ambient = glm::vec3(1, 1, 1);
+		mirror.diffuse = glm::vec3(1, 1, 1);
+		mirror.specular = glm::vec3(1, 1, 1);
+		mirror.specularExponent = 50;
+		mirror.Klocal = 0;
+		mirror.Kreflectivity = 1;
+
+	Material greyMirror = Material();
+		greyMirror.ambient = glm::vec3(0.5, 0.5, 0.5);
+		greyMirror.diffuse = glm::vec3(0.5, 0.5, 0.5);
+		greyMirror.specular = glm::vec3(1, 1, 1);
+		greyMirror.specularExponent = 50;
+		greyMirror.Klocal = 0.4;
+		greyMirror.Kreflectivity = 0.6;
+
+	Material purple = Material();
+		purple.ambient = glm::vec3(1, 0, 1);
+		purple.diffuse = glm::vec3(1, 0, 1);
+		purple.specular = glm::vec3(1, 1, 1);
+		purple.specularExponent = 10;
+		purple.Klocal = 1;
+		purple.Kreflectivity = 0;
+
+	Material black = Material();
+		black.ambient = glm::vec3(0, 0, 0);
+		black.diffuse = glm::vec3(0, 0, 0);
+		black.specular = glm::vec3(1, 1, 1);
+		black.specularExponent = 10;
+		black.Klocal = 1;
+		black.Kreflectivity = 0;
+
+	Material pink = Material();
+		pink.ambient = glm::vec3(1, 0.7, 0.7);
+		pink.diffuse = glm::vec3(1, 0.7, 0.7);
+		pink.specular = glm::vec3(1, 1, 1);
+		pink.specularExponent = 10;
+		pink.Klocal = 1;
+		pink.Kreflectivity = 0;
+
+	// Create the objects for the given scene
+	switch (number) {
+	// The standard scene with a shiny green sphere and a grey triangular mirror in a room
+	// The room has a red left hand wall, blue right hand wall and white ceiling/floor
+	// The backwall is a perfect mirror
+	case 1 : {
+		// Planes
+		scene->Add(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror)); // Backwall
+		scene->Add(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red)); // RHS wall
+		scene->Add(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue)); // LHS wall
+		scene->Add(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white)); // floor
+		scene->Add(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb)); // ceiling
+
+		// Spheres
+		scene->Add(new Sphere(30, glm::vec3(40, -30, 70), shinyGreen));
+
+		// Triangles
+		scene->Add(new Triangle(glm::vec3(-30, -60, 100),  glm::vec3(-0, -60, 60), glm::vec3(-40, -30, 80), greyMirror));
+		break;
+	}
+	// A large sphere of perfect mirror reflects a smaller red sphere
+	// Used to double check the reflections look correct
+	case 2 : {
+		// Planes
+		scene->Add(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), white)); // Backwall
+		scene->Add(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red)); // RHS wall
+		scene->Add(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue)); // LHS wall
+		scene->Add(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white)); // floor
+		scene->Add(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb)); // ceiling
+
+		// Spheres
+		scene->Add(new Sphere(20, glm::vec3(0, -40, 150), red));
+		scene->Add(new Sphere(40, glm::vec3(0, -20, 70), mirror));
+
+		// Triangles
+		//scene->Add(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen));
+		break;
+	}
+	// Create a 'face' for the viewer behind the camera which can only be seen by the reflection in the backwall and small
+	// triangular mirror
+	case 3 : {
+		// Planes
+		scene->Add(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror)); // Backwall
+		scene->Add(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red)); // RHS wall
+		scene->Add(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue)); // LHS wall
+		scene->Add(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white)); // floor
+		scene->Add(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb)); // ceiling
+
+		// Spheres
+		scene->Add(new Sphere(30, glm::vec3(0, 0, 250), pink));
+		scene->Add(new Sphere(5, glm::vec3(0, 0, 220), pink));
+		scene->Add(new Sphere(10, glm::vec3(-10, 10, 230), whiteAbsorb));
+		scene->Add(new Sphere(10, glm::vec3(10, 10, 230), whiteAbsorb));
+		scene->Add(new Sphere(5, glm::vec3(-10, 10, 222), black));
+		scene->Add(new Sphere(5, glm::vec3(10, 10, 222), black));
+
+		// Triangles
+		scene->Add(new Triangle(glm::vec3(-30, -60, 140),  glm::vec3(-0, -60, 130), glm::vec3(-40, -30, 120), greyMirror));
+		//scene->Add(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen));
+		break;
+	}
+	// Shining a light into a mirrored box containing the basic pink 'face'
+	case 4 : {
+		scene->lightPos = glm::vec3(0, 0, 200);
+		// Planes
+		scene->Add(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), greyMirror)); // Backwall
+		scene->Add(new Plane(glm::vec3(40, 0, 0), glm::vec3(-1, 0, 0), greyMirror)); // RHS wall
+		scene->Add(new Plane(glm::vec3(-40, 0, 0), glm::vec3(1, 0, 0), greyMirror)); // LHS wall
+		scene->Add(new Plane(glm::vec3(0, -30, 0), glm::vec3(0, 1, 0), greyMirror)); // floor
+		scene->Add(new Plane(glm::vec3(0, 30, 0), glm::vec3(0, -1, 0), greyMirror)); // ceiling
+
+		// Spheres
+		scene->Add(new Sphere(20, glm::vec3(0, -10, 100), pink));
+		scene->Add(new Sphere(5, glm::vec3(0, -10, 120), pink));
+		scene->Add(new Sphere(10, glm::vec3(-10, 0, 110), whiteAbsorb));
+		scene->Add(new Sphere(10, glm::vec3(10, 0, 110), whiteAbsorb));
+		scene->Add(new Sphere(5, glm::vec3(-10, 0, 118), black));
+		scene->Add(new Sphere(5, glm::vec3(10, 0, 118), black));
+
+		// Triangles
+		//scene->Add(new Triangle(glm::vec3(-30,-60,140),  glm::vec3(-0,-60,130),glm::vec3(-40,-30,120), greyMirror));
+		//scene->Add(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen));
+		break;
+	}
+	// Test of additional feature - axis-aligned box
+	case 5 : {
+		// Planes
+		scene->Add(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror)); // Backwall
+		scene->Add(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red)); // RHS wall
+		scene->Add(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue)); // LHS wall
+		scene->Add(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white)); // floor
+		scene->Add(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb)); // ceiling
+
+		// Spheres
+		//scene->Add(new Sphere(30, glm::vec3(40,-30, 70), shinyGreen));
+
+		// Triangles
+		//scene->Add(new Triangle(glm::vec3(-30,-60,100),  glm::vec3(-0,-60,60),glm::vec3(-40,-30,80), greyMirror));
+
+		//Boxes
+		scene->Add(new AxisAlignedBox(glm::vec3(-50, -50, 100),  glm::vec3(-20, -20, 70), shinyGreen));
+		break;
+	}
+	default :
+		break;
+	}
+
+	scene->Finalize();
+	return scene;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Object.h"
+#include "PrimitiveStore.h"
+#include "BVH.h"
+#include "Camera.h"
+
+class MappedFile;
+
+//Everything in the world that is rendered: the objects, the light and the camera
+//A scene is filled in once by a loader (e.g. LoadDemoScene) and then finalised, after which its
+//objects are never changed. Rendering only reads it, so one scene can be shared by all the render threads
+//and redrawing the window does not have to rebuild anything. The light can be moved between frames
+//Finalising compiles the objects into a PrimitiveStore, which is what rays are actually tested against
+class Scene
+{
+public:
+	Scene();
+	~Scene();
+
+	//Add an object to the scene, the scene takes ownership of it
+	//Only allowed before Finalize is called
+	void Add(Object *object);
+
+	//The storage the objects are compiled into, for loaders that add primitives to it directly rather than
+	//creating an Object for each one (e.g. LoadSceneFile)
+	//Only allowed before Finalize is called
+	PrimitiveStore &Primitives() { return _primitives; }
+
+	//Compile the objects into compact primitive storage and build the acceleration structure over it
+	//The objects themselves are released. Must be called once after the last object is added
+	void Finalize();
+
+	//Call f on each of the arrays of compiled primitives and materials, or of the acceleration structure
+	//Used by the scene cache (SceneCache.h) to save the arrays and to attach them to a mapped cache file
+	template<class F> void ForEachPrimitiveArray(F &f) { _primitives.ForEachArray(f); }
+	template<class F> void ForEachBVHArray(F &f) { _bvh.ForEachArray(f); }
+
+	//Finalise a scene whose arrays have been attached to a mapped scene cache instead of being compiled from objects
+	//Builds the acceleration structure if the cache did not include one
+	//@mapping The mapped file, which the scene keeps open for as long as its arrays refer to it
+	//returns false if an index in the arrays is out of range, in which case the scene must not be used
+	bool FinalizeMapped(unique_ptr<MappedFile> mapping);
+
+	//Function for testing for intersection with all the objects in the scene
+	//If an object is hit then info contains the information on the intersection,
+	//returns true if an object is hit, false otherwise
+	bool Intersect(const Ray &ray, IntersectInfo &info) const;
+
+	//Test whether anything in the scene is hit before tMax, e.g. between a point and the light
+	//Returns as soon as any hit is found and does not fill in the details of it
+	//@ray The ray that we are testing for intersection
+	//@tMax Hits at or beyond this time along the ray are ignored
+	bool Occluded(const Ray &ray, float tMax) const;
+
+	//Packet version of Intersect, finds the closest object hit by each of the rays in the packet
+	//@packet The rays that we are testing for intersection
+	//@time Per ray, set to the time of the closest hit. Must start as infinity, or 0 for lanes that should not be traced
+	//@hits Per ray, set to the closest hit. Pass it to IntersectInfoFor to get the details of the hit
+	//returns the lanes in which a primitive was hit
+	SimdMask IntersectPacket(const RayPacket &packet, SimdFloat &time, PrimitiveHit hits[]) const;
+
+	//Packet version of Occluded
+	//@packet The rays that we are testing for intersection
+	//@tMax Per ray, hits at or beyond this time along the ray are ignored. Rays with a tMax of 0 or less are ignored
+	//returns the lanes in which something is in the way
+	SimdMask OccludedPacket(const RayPacket &packet, const SimdFloat &tMax) const;
+
+	//Work out the details of a hit found by IntersectPacket
+	//@hit The hit, from IntersectPacket
+	void IntersectInfoFor(const Ray &ray, const PrimitiveHit &hit, IntersectInfo &info) const
+	{
+		_primitives.IntersectInfoFor(ray, hit, info);
+	}
+
+	//Returns the number of objects in the scene
+	size_t NumObjects() const { return _finalized ? _primitives.Size() : _objects.size(); }
+
+	glm::vec3 lightPos; // The position of the point light source
+	Camera camera; // What the scene is seen from
+
+private:
+	Scene(const Scene &);
+	Scene &operator =(const Scene &);
+
+	// The objects added to the scene, only kept until the scene is finalised
+	vector<unique_ptr<Object>> _objects;
+	// The compiled objects. Planes have no bounding box and are always tested
+	PrimitiveStore _primitives;
+	// Acceleration structure over the bounded primitives (spheres, triangles and boxes)
+	BVH _bvh;
+	bool _finalized;
+	// The scene cache the arrays refer to, if the scene was loaded from one
+	unique_ptr<MappedFile> _mapping;
+};
+
+//Build one of the demonstration scenes
+//@number The scene to build:
+// 1 - The basic scene with a sphere, triangle and planes
+// 2 - A scene with two spheres to test reflection
+// 3 - A scene to test reflection behind the camera
+// 4 - A box of mirrors to test bouncing reflections
+// 5 - Test of the new AxisAlignedBox object
+//returns the finalised scene, which is empty for an unknown number
+unique_ptr<Scene> LoadDemoScene(int number);
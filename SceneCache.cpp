@@ -0,0 +1,182 @@
+#include "SceneCache.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstdint>
+
+#include "glm/gtc/type_ptr.hpp"
+
+//Identifies a scene cache file
+static const char kCacheMagic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+//Changed whenever the layout of the file or of any of the arrays changes
+static const uint32_t kCacheVersion = 4;
+//Every array starts on a multiple of this many bytes in the file, and so in memory once it is mapped
+static const uint64_t kCacheAlignment = 64;
+
+//The start of the file, followed by one CacheArray for each array in the scene
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t numArrays;
+	float lightPos[3];
+	float cameraMatrix[16]; // Camera space to world space, column by column
+	float cameraFov;
+	float cameraAspect;
+	uint32_t padding;
+};
+
+//Where one array is in the file
+struct CacheArray
+{
+	uint64_t offset; // From the start of the file
+	uint64_t count; // Number of elements
+	uint64_t elementSize; // Catches a cache written by a build whose structures have a different size
+};
+
+//Collects the arrays of a scene and where each one goes in the file
+struct CacheWriter
+{
+	vector<const void *> data;
+	vector<CacheArray> arrays;
+	bool skip; // Record the arrays as empty, e.g. to leave out the acceleration structure
+
+	template<class T> void operator()(const Array<T> &values)
+	{
+		CacheArray entry;
+		entry.offset = 0;
+		entry.count = skip ? 0 : values.size();
+		entry.elementSize = sizeof(T);
+		data.push_back(values.data());
+		arrays.push_back(entry);
+	}
+};
+
+//Points each array of a scene at its place in a mapped cache, in the order they were written
+struct CacheAttacher
+{
+	const MappedFile &file;
+	const CacheArray *arrays;
+	uint32_t numArrays;
+	uint32_t next;
+	bool ok;
+
+	template<class T> void operator()(Array<T> &values)
+	{
+		if (!ok || next >= numArrays) {
+			ok = false;
+			return;
+		}
+		const CacheArray &entry = arrays[next++];
+		uint64_t size = file.Size();
+		if (entry.elementSize != sizeof(T) || entry.offset % kCacheAlignment != 0 || entry.offset > size ||
+		    entry.count > (size - entry.offset) / sizeof(T)) {
+			ok = false;
+			return;
+		}
+		values.Attach(entry.count == 0 ? NULL : (T *)(file.Data() + entry.offset), (size_t)entry.count);
+	}
+};
+
+//Returns the offset rounded up to the alignment of the arrays
+static uint64_t AlignOffset(uint64_t offset)
+{
+	return (offset + kCacheAlignment - 1) / kCacheAlignment * kCacheAlignment;
+}
+
+bool SaveSceneCache(const Scene &scene, const string &path, bool includeBVH)
+{
+	// The writer only reads the arrays
+	Scene &arrays = const_cast<Scene &>(scene);
+	CacheWriter writer;
+	writer.skip = false;
+	arrays.ForEachPrimitiveArray(writer);
+	writer.skip = !includeBVH;
+	arrays.ForEachBVHArray(writer);
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+	header.version = kCacheVersion;
+	header.numArrays = (uint32_t)writer.arrays.size();
+	for (int i = 0; i < 3; ++i) {
+		header.lightPos[i] = scene.lightPos[i];
+	}
+	memcpy(header.cameraMatrix, glm::value_ptr(scene.camera.ViewMatrix()), sizeof(header.cameraMatrix));
+	header.cameraFov = scene.camera.fov;
+	header.cameraAspect = scene.camera.aspect;
+
+	// Lay the arrays out one after another after the header and the table of arrays
+	uint64_t offset = sizeof(CacheHeader) + writer.arrays.size() * sizeof(CacheArray);
+	for (size_t i = 0; i < writer.arrays.size(); ++i) {
+		offset = AlignOffset(offset);
+		writer.arrays[i].offset = offset;
+		offset += writer.arrays[i].count * writer.arrays[i].elementSize;
+	}
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		cerr << "Could not write scene cache " << path << endl;
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!writer.arrays.empty()) {
+		ok = ok && fwrite(&writer.arrays[0], sizeof(CacheArray), writer.arrays.size(), file) == writer.arrays.size();
+	}
+	const char padding[kCacheAlignment] = {};
+	uint64_t written = sizeof(CacheHeader) + writer.arrays.size() * sizeof(CacheArray);
+	for (size_t i = 0; i < writer.arrays.size() && ok; ++i) {
+		const CacheArray &entry = writer.arrays[i];
+		ok = fwrite(padding, 1, (size_t)(entry.offset - written), file) == entry.offset - written;
+		size_t bytes = (size_t)(entry.count * entry.elementSize);
+		ok = ok && (bytes == 0 || fwrite(writer.data[i], 1, bytes, file) == bytes);
+		written = entry.offset + bytes;
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (!ok) {
+		cerr << "Could not write scene cache " << path << endl;
+	}
+	return ok;
+}
+
+unique_ptr<Scene> LoadSceneCache(const string &path)
+{
+	unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(path)) {
+		cerr << "Could not open scene cache " << path << endl;
+		return unique_ptr<Scene>();
+	}
+
+	// The mapping is page aligned, so the header and the table of arrays that follows it are aligned too
+	const CacheHeader &header = *(const CacheHeader *)file->Data();
+	if (file->Size() < sizeof(CacheHeader) || memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0) {
+		cerr << path << " is not a scene cache" << endl;
+		return unique_ptr<Scene>();
+	}
+	if (header.version != kCacheVersion ||
+	    header.numArrays > (file->Size() - sizeof(CacheHeader)) / sizeof(CacheArray)) {
+		cerr << path << " is damaged or was written by a different build, save the scene cache again" << endl;
+		return unique_ptr<Scene>();
+	}
+
+	unique_ptr<Scene> scene(new Scene());
+	scene->lightPos = glm::vec3(header.lightPos[0], header.lightPos[1], header.lightPos[2]);
+	scene->camera.SetViewMatrix(glm::make_mat4(header.cameraMatrix));
+	scene->camera.fov = header.cameraFov;
+	scene->camera.aspect = header.cameraAspect;
+
+	CacheAttacher attacher = { *file, (const CacheArray *)(file->Data() + sizeof(CacheHeader)), header.numArrays, 0, true };
+	scene->ForEachPrimitiveArray(attacher);
+	scene->ForEachBVHArray(attacher);
+	if (!attacher.ok || attacher.next != header.numArrays) {
+		cerr << path << " is damaged or was written by a different build, save the scene cache again" << endl;
+		return unique_ptr<Scene>();
+	}
+
+	// The indices the arrays hold are checked too, as any of them being out of range would crash the render
+	if (!scene->FinalizeMapped(std::move(file))) {
+		cerr << path << " is damaged or was written by a different build, save the scene cache again" << endl;
+		return unique_ptr<Scene>();
+	}
+	return scene;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Scene.h"
+
+//A scene cache is a finalised scene saved in binary: the compiled primitive arrays, the material table and
+//optionally the prebuilt acceleration structure, each aligned in the file exactly as they are laid out in memory
+//Loading one maps the file and points the scene's arrays straight into it, so there is nothing to parse, copy
+//or build and even very large scenes are ready to render almost at once
+//The file is in the native layout and byte order of the build that wrote it. It is a cache to speed up
+//reloading the same scene, e.g. for batch renders, rather than a format for exchanging scenes
+
+//Save a finalised scene to a scene cache
+//@scene The scene to save
+//@path The file to write
+//@includeBVH Whether to save the acceleration structure. Without it the file is smaller but the
+//acceleration structure has to be built again each time the cache is loaded
+//returns false if the file could not be written
+bool SaveSceneCache(const Scene &scene, const string &path, bool includeBVH = true);
+
+//Load a scene saved with SaveSceneCache
+//The scene keeps the file mapped for as long as it exists
+//@path The file to load
+//returns the finalised scene, or nothing if the file could not be loaded or is not a scene cache from this build (which is printed)
+unique_ptr<Scene> LoadSceneCache(const string &path);
@@ -0,0 +1,367 @@
+#include "SceneFile.h"
+#include "ParseNumber.h"
+#include "ObjFile.h"
+
+#include <cstdio>
+#include <cctype>
+#include <unordered_map>
+
+//Reads a scene file that has been loaded into memory
+//Scene files can hold millions of primitives, so the numbers are parsed by hand rather than with streams or strtod
+class SceneFileParser
+{
+public:
+	//@text The contents of the file followed by a null character, which marks the end so that the parser never
+	//has to check how far it is through the text
+	SceneFileParser(const string &path, const char *text):
+		_path(path),
+		_pos(text),
+		_line(1)
+	{
+	}
+
+	//Read the whole file into the scene
+	//returns false if there is an error, which has been printed
+	bool Parse(Scene &scene)
+	{
+		PrimitiveStore &primitives = scene.Primitives();
+		string keyword;
+		while (*_pos != '\0') {
+			SkipSpace();
+			if (AtEndOfLine()) {
+				NextLine();
+				continue;
+			}
+			ReadWord(keyword);
+
+			bool ok;
+			glm::vec3 a, b, c;
+			int material;
+			if (keyword == "sphere") {
+				float radius;
+				ok = ReadMaterial(material) && ReadVec3(a) && ReadFloat(radius);
+				if (ok) {
+					primitives.AddSphere(a, radius, material);
+				}
+			}
+			else if (keyword == "triangle") {
+				ok = ReadMaterial(material) && ReadVec3(a) && ReadVec3(b) && ReadVec3(c);
+				if (ok) {
+					primitives.AddTriangle(a, b, c, material);
+				}
+			}
+			else if (keyword == "plane") {
+				ok = ReadMaterial(material) && ReadVec3(a) && ReadVec3(b);
+				if (ok) {
+					primitives.AddPlane(a, b, material);
+				}
+			}
+			else if (keyword == "box") {
+				ok = ReadMaterial(material) && ReadVec3(a) && ReadVec3(b);
+				if (ok) {
+					primitives.AddBox(a, b, material);
+				}
+			}
+			else if (keyword == "mesh") {
+				ok = ParseMesh(primitives);
+			}
+			else if (keyword == "material") {
+				ok = ParseMaterial(primitives);
+			}
+			else if (keyword == "camera") {
+				ok = ParseCamera(scene.camera);
+			}
+			else if (keyword == "light") {
+				ok = ReadVec3(scene.lightPos);
+			}
+			else {
+				ok = Error("unknown keyword '" + keyword + "'");
+			}
+			if (!ok) {
+				return false;
+			}
+
+			SkipSpace();
+			if (!AtEndOfLine()) {
+				return Error("unexpected text at the end of the line");
+			}
+			NextLine();
+		}
+		return true;
+	}
+
+private:
+	//Parse the rest of a camera line
+	bool ParseCamera(Camera &camera)
+	{
+		glm::vec3 position;
+		if (!ReadVec3(position)) {
+			return false;
+		}
+		SkipSpace();
+		if (!AtEndOfLine() && !isalpha((unsigned char)*_pos) && !ReadFloat(camera.fov)) {
+			return false;
+		}
+
+		string property;
+		bool lookAt = false;
+		glm::vec3 target(position - glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::vec3 up(0.0f, 1.0f, 0.0f);
+		for (;;) {
+			SkipSpace();
+			if (AtEndOfLine()) {
+				break;
+			}
+			ReadWord(property);
+			bool ok;
+			if (property == "lookat") {
+				ok = ReadVec3(target);
+				lookAt = true;
+			}
+			else if (property == "up") {
+				ok = ReadVec3(up);
+				lookAt = true;
+			}
+			else if (property == "aspect") {
+				ok = ReadFloat(camera.aspect) && (camera.aspect > 0.0f || Error("the aspect ratio must be positive"));
+			}
+			else {
+				ok = Error("unknown camera property '" + property + "'");
+			}
+			if (!ok) {
+				return false;
+			}
+		}
+		if (!lookAt) {
+			camera.SetPosition(position);
+		}
+		else if (target == position || glm::length(glm::cross(target - position, up)) == 0.0f) {
+			return Error("the camera must look at a point other than its position, and not along its up direction");
+		}
+		else {
+			camera.LookAt(position, target, up);
+		}
+		return true;
+	}
+
+	//Parse the rest of a material line and add the material to the table
+	bool ParseMaterial(PrimitiveStore &primitives)
+	{
+		string name, property;
+		SkipSpace();
+		if (AtEndOfLine()) {
+			return Error("expected a material name");
+		}
+		ReadWord(name);
+
+		Material material;
+		material.Klocal = 1.0f;
+		material.Kreflectivity = 0.0f;
+		for (;;) {
+			SkipSpace();
+			if (AtEndOfLine()) {
+				break;
+			}
+			ReadWord(property);
+			bool ok;
+			if (property == "ambient") {
+				ok = ReadVec3(material.ambient);
+			}
+			else if (property == "diffuse") {
+				ok = ReadVec3(material.diffuse);
+			}
+			else if (property == "specular") {
+				ok = ReadVec3(material.specular);
+			}
+			else if (property == "exponent") {
+				ok = ReadFloat(material.specularExponent);
+			}
+			else if (property == "local") {
+				ok = ReadFloat(material.Klocal);
+			}
+			else if (property == "reflect") {
+				ok = ReadFloat(material.Kreflectivity);
+			}
+			else {
+				ok = Error("unknown material property '" + property + "'");
+			}
+			if (!ok) {
+				return false;
+			}
+		}
+		if (_materials.count(name) != 0) {
+			return Error("material '" + name + "' is defined twice");
+		}
+		_materials[name] = primitives.AddMaterial(material);
+		return true;
+	}
+
+	//Parse the rest of a mesh line and import the OBJ file it names
+	bool ParseMesh(PrimitiveStore &primitives)
+	{
+		int material;
+		string file, property;
+		if (!ReadMaterial(material)) {
+			return false;
+		}
+		SkipSpace();
+		if (AtEndOfLine()) {
+			return Error("expected an OBJ file name");
+		}
+		ReadWord(file);
+		// A relative path is relative to the folder the scene file is in
+		size_t folderEnd = _path.find_last_of("/\\");
+		if (file[0] != '/' && folderEnd != string::npos) {
+			file = _path.substr(0, folderEnd + 1) + file;
+		}
+
+		float scale = 1.0f;
+		glm::vec3 translate(0.0f);
+		for (;;) {
+			SkipSpace();
+			if (AtEndOfLine()) {
+				break;
+			}
+			ReadWord(property);
+			bool ok;
+			if (property == "scale") {
+				ok = ReadFloat(scale);
+			}
+			else if (property == "translate") {
+				ok = ReadVec3(translate);
+			}
+			else {
+				ok = Error("unknown mesh property '" + property + "'");
+			}
+			if (!ok) {
+				return false;
+			}
+		}
+		glm::mat4 transform = glm::scale(glm::translate(glm::mat4(1.0f), translate), glm::vec3(scale));
+		if (!LoadObjFile(file, primitives, material, _materials, transform)) {
+			return Error("could not load mesh " + file);
+		}
+		return true;
+	}
+
+	//Read the name of a material that has already been defined
+	bool ReadMaterial(int &material)
+	{
+		SkipSpace();
+		if (AtEndOfLine()) {
+			return Error("expected a material name");
+		}
+		ReadWord(_word);
+		// Consecutive primitives almost always share a material, so avoid the lookup when it is the same as last time
+		if (_word != _lastMaterialName) {
+			unordered_map<string, int>::const_iterator found = _materials.find(_word);
+			if (found == _materials.end()) {
+				return Error("undefined material '" + _word + "'");
+			}
+			_lastMaterialName = _word;
+			_lastMaterial = found->second;
+		}
+		material = _lastMaterial;
+		return true;
+	}
+
+	bool ReadVec3(glm::vec3 &v)
+	{
+		return ReadFloat(v.x) && ReadFloat(v.y) && ReadFloat(v.z);
+	}
+
+	//Read a number that ends at a space or the end of the line
+	bool ReadFloat(float &value)
+	{
+		SkipSpace();
+		if (!ParseFloat(_pos, value) || (!IsSpace(*_pos) && !AtEndOfLine())) {
+			return Error("expected a number");
+		}
+		return true;
+	}
+
+	//Read the characters up to the next space
+	void ReadWord(string &word)
+	{
+		const char *start = _pos;
+		while (!IsSpace(*_pos) && !AtEndOfLine()) {
+			++_pos;
+		}
+		word.assign(start, _pos);
+	}
+
+	static bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	void SkipSpace()
+	{
+		while (IsSpace(*_pos)) {
+			++_pos;
+		}
+	}
+
+	//True at the end of the line, the end of the file or the start of a comment
+	bool AtEndOfLine() const
+	{
+		return *_pos == '\0' || *_pos == '\n' || *_pos == '\r' || *_pos == '#';
+	}
+
+	//Skip the rest of the line, including any comment
+	void NextLine()
+	{
+		while (*_pos != '\0' && *_pos != '\n') {
+			++_pos;
+		}
+		if (*_pos == '\n') {
+			++_pos;
+			++_line;
+		}
+	}
+
+	//Print an error with the position in the file
+	//returns false so that it can be returned straight from a parse function
+	bool Error(const string &message) const
+	{
+		cerr << _path << ":" << _line << ": " << message << endl;
+		return false;
+	}
+
+	string _path;
+	const char *_pos;
+	int _line;
+	unordered_map<string, int> _materials; // Material name to index in the material table
+	string _word;
+	string _lastMaterialName;
+	int _lastMaterial;
+};
+
+unique_ptr<Scene> LoadSceneFile(const string &path)
+{
+	// Read the whole file in one go, the parser then works straight from memory
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		cerr << "Could not open scene file " << path << endl;
+		return unique_ptr<Scene>();
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	vector<char> text(size > 0 ? size + 1 : 1);
+	bool read = fread(&text[0], 1, text.size() - 1, file) == text.size() - 1;
+	fclose(file);
+	if (!read) {
+		cerr << "Could not read scene file " << path << endl;
+		return unique_ptr<Scene>();
+	}
+
+	unique_ptr<Scene> scene(new Scene());
+	text.back() = '\0';
+	SceneFileParser parser(path, &text[0]);
+	if (!parser.Parse(*scene)) {
+		return unique_ptr<Scene>();
+	}
+	scene->Finalize();
+	return scene;
+}
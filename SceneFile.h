@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Scene.h"
+
+//Scene files describe a scene as text, one item per line. Blank lines and anything after a # are ignored
+//
+//  camera <x> <y> <z> [fov] [lookat <x> <y> <z>] [up <x> <y> <z>] [aspect <a>]
+//                               Camera position and vertical field of view in degrees (default 90). The camera looks
+//                               down the negative z axis unless it is given a point to look at, with y up unless
+//                               given another up direction. The aspect ratio defaults to the shape of the image
+//  light <x> <y> <z>            Position of the point light
+//  material <name> [ambient <r> <g> <b>] [diffuse <r> <g> <b>] [specular <r> <g> <b>]
+//                  [exponent <e>] [local <k>] [reflect <k>]
+//                               Define a material. Unset values default to white, exponent 10, local 1 and reflect 0
+//  sphere <material> <cx> <cy> <cz> <radius>
+//  plane <material> <px> <py> <pz> <nx> <ny> <nz>            A point on the plane and its normal
+//  triangle <material> <ax> <ay> <az> <bx> <by> <bz> <cx> <cy> <cz>
+//  box <material> <x1> <y1> <z1> <x2> <y2> <z2>              Two opposite corners of an axis-aligned box
+//  mesh <material> <file> [scale <s>] [translate <x> <y> <z>]
+//                               A triangle mesh imported from a Wavefront OBJ file, relative to the scene file's folder.
+//                               Scaled then moved into place. usemtl lines in the OBJ file can choose other materials
+//                               defined in the scene file by name
+//
+//Materials must be defined before they are used. See the scenes folder for examples
+
+//Build a scene from a scene file
+//The primitives go straight into the scene's primitive storage without creating an Object for each one,
+//so large files load quickly
+//@path The file to read
+//returns the finalised scene, or nothing if the file could not be read or has an error (which is printed)
+unique_ptr<Scene> LoadSceneFile(const string &path);
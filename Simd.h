@@ -0,0 +1,153 @@
+#pragma once
+
+#include "header.h"
+
+//Thin wrappers over the SIMD registers used for packet tracing
+//A SimdFloat holds kSimdWidth floats that are operated on together: 8 with AVX, 4 with SSE, and a plain
+//array of 4 (with loops) when neither is available so that the code still builds everywhere.
+//Comparisons give a SimdMask with every bit of a lane set where the comparison is true.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_SIMD_AVX
+static const int kSimdWidth = 8;
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RT_SIMD_SSE
+static const int kSimdWidth = 4;
+#else
+static const int kSimdWidth = 4;
+#endif
+
+#if defined(RT_SIMD_AVX)
+
+struct SimdMask
+{
+	__m256 v;
+	SimdMask() {}
+	explicit SimdMask(__m256 v): v(v) {}
+	explicit SimdMask(bool b): v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0))) {}
+	//Returns one bit per lane, bit i is set if lane i is true
+	int Bits() const { return _mm256_movemask_ps(v); }
+};
+
+struct SimdFloat
+{
+	__m256 v;
+	SimdFloat() {}
+	explicit SimdFloat(__m256 v): v(v) {}
+	SimdFloat(float f): v(_mm256_set1_ps(f)) {}
+	static SimdFloat Load(const float *p) { return SimdFloat(_mm256_loadu_ps(p)); }
+	void Store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline SimdFloat operator +(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_add_ps(a.v, b.v)); }
+inline SimdFloat operator -(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_sub_ps(a.v, b.v)); }
+inline SimdFloat operator *(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_mul_ps(a.v, b.v)); }
+inline SimdFloat operator /(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_div_ps(a.v, b.v)); }
+inline SimdFloat Min(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_min_ps(a.v, b.v)); }
+inline SimdFloat Max(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_max_ps(a.v, b.v)); }
+inline SimdFloat Sqrt(const SimdFloat &a) { return SimdFloat(_mm256_sqrt_ps(a.v)); }
+inline SimdFloat Abs(const SimdFloat &a) { return SimdFloat(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+inline SimdMask operator <(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+inline SimdMask operator <=(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+inline SimdMask operator >(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+inline SimdMask operator >=(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+inline SimdMask operator ==(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)); }
+inline SimdMask operator &(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm256_and_ps(a.v, b.v)); }
+inline SimdMask operator |(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm256_or_ps(a.v, b.v)); }
+//Returns a & ~b
+inline SimdMask AndNot(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm256_andnot_ps(b.v, a.v)); }
+//Per lane: mask ? a : b
+inline SimdFloat Select(const SimdMask &mask, const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm256_blendv_ps(b.v, a.v, mask.v)); }
+
+#elif defined(RT_SIMD_SSE)
+
+struct SimdMask
+{
+	__m128 v;
+	SimdMask() {}
+	explicit SimdMask(__m128 v): v(v) {}
+	explicit SimdMask(bool b): v(_mm_castsi128_ps(_mm_set1_epi32(b ? -1 : 0))) {}
+	//Returns one bit per lane, bit i is set if lane i is true
+	int Bits() const { return _mm_movemask_ps(v); }
+};
+
+struct SimdFloat
+{
+	__m128 v;
+	SimdFloat() {}
+	explicit SimdFloat(__m128 v): v(v) {}
+	SimdFloat(float f): v(_mm_set1_ps(f)) {}
+	static SimdFloat Load(const float *p) { return SimdFloat(_mm_loadu_ps(p)); }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+};
+
+inline SimdFloat operator +(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_add_ps(a.v, b.v)); }
+inline SimdFloat operator -(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_sub_ps(a.v, b.v)); }
+inline SimdFloat operator *(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_mul_ps(a.v, b.v)); }
+inline SimdFloat operator /(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_div_ps(a.v, b.v)); }
+inline SimdFloat Min(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_min_ps(a.v, b.v)); }
+inline SimdFloat Max(const SimdFloat &a, const SimdFloat &b) { return SimdFloat(_mm_max_ps(a.v, b.v)); }
+inline SimdFloat Sqrt(const SimdFloat &a) { return SimdFloat(_mm_sqrt_ps(a.v)); }
+inline SimdFloat Abs(const SimdFloat &a) { return SimdFloat(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+inline SimdMask operator <(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm_cmplt_ps(a.v, b.v)); }
+inline SimdMask operator <=(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm_cmple_ps(a.v, b.v)); }
+inline SimdMask operator >(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm_cmpgt_ps(a.v, b.v)); }
+inline SimdMask operator >=(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm_cmpge_ps(a.v, b.v)); }
+inline SimdMask operator ==(const SimdFloat &a, const SimdFloat &b) { return SimdMask(_mm_cmpeq_ps(a.v, b.v)); }
+inline SimdMask operator &(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm_and_ps(a.v, b.v)); }
+inline SimdMask operator |(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm_or_ps(a.v, b.v)); }
+//Returns a & ~b
+inline SimdMask AndNot(const SimdMask &a, const SimdMask &b) { return SimdMask(_mm_andnot_ps(b.v, a.v)); }
+//Per lane: mask ? a : b
+inline SimdFloat Select(const SimdMask &mask, const SimdFloat &a, const SimdFloat &b)
+{
+	return SimdFloat(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+}
+
+#else
+
+struct SimdMask
+{
+	bool v[kSimdWidth];
+	SimdMask() {}
+	explicit SimdMask(bool b) { for (int i = 0; i < kSimdWidth; ++i) v[i] = b; }
+	//Returns one bit per lane, bit i is set if lane i is true
+	int Bits() const { int bits = 0; for (int i = 0; i < kSimdWidth; ++i) bits |= v[i] << i; return bits; }
+};
+
+struct SimdFloat
+{
+	float v[kSimdWidth];
+	SimdFloat() {}
+	SimdFloat(float f) { for (int i = 0; i < kSimdWidth; ++i) v[i] = f; }
+	static SimdFloat Load(const float *p) { SimdFloat r; for (int i = 0; i < kSimdWidth; ++i) r.v[i] = p[i]; return r; }
+	void Store(float *p) const { for (int i = 0; i < kSimdWidth; ++i) p[i] = v[i]; }
+};
+
+#define RT_SIMD_LANEWISE(type, expr) type r; for (int i = 0; i < kSimdWidth; ++i) r.v[i] = (expr); return r;
+inline SimdFloat operator +(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, a.v[i] + b.v[i]) }
+inline SimdFloat operator -(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, a.v[i] - b.v[i]) }
+inline SimdFloat operator *(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, a.v[i] * b.v[i]) }
+inline SimdFloat operator /(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, a.v[i] / b.v[i]) }
+inline SimdFloat Min(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, b.v[i] < a.v[i] ? b.v[i] : a.v[i]) }
+inline SimdFloat Max(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, b.v[i] > a.v[i] ? b.v[i] : a.v[i]) }
+inline SimdFloat Sqrt(const SimdFloat &a) { RT_SIMD_LANEWISE(SimdFloat, std::sqrt(a.v[i])) }
+inline SimdFloat Abs(const SimdFloat &a) { RT_SIMD_LANEWISE(SimdFloat, std::fabs(a.v[i])) }
+inline SimdMask operator <(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] < b.v[i]) }
+inline SimdMask operator <=(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] <= b.v[i]) }
+inline SimdMask operator >(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] > b.v[i]) }
+inline SimdMask operator >=(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] >= b.v[i]) }
+inline SimdMask operator ==(const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] == b.v[i]) }
+inline SimdMask operator &(const SimdMask &a, const SimdMask &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] && b.v[i]) }
+inline SimdMask operator |(const SimdMask &a, const SimdMask &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] || b.v[i]) }
+//Returns a & ~b
+inline SimdMask AndNot(const SimdMask &a, const SimdMask &b) { RT_SIMD_LANEWISE(SimdMask, a.v[i] && !b.v[i]) }
+//Per lane: mask ? a : b
+inline SimdFloat Select(const SimdMask &mask, const SimdFloat &a, const SimdFloat &b) { RT_SIMD_LANEWISE(SimdFloat, mask.v[i] ? a.v[i] : b.v[i]) }
+#undef RT_SIMD_LANEWISE
+
+#endif
+
+//Returns true if any lane of the mask is set
+inline bool Any(const SimdMask &mask) { return mask.Bits() != 0; }
@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned numThreads):
+	_task(NULL),
+	_remaining(0),
+	_batch(0),
+	_stop(false)
+{
+	if (numThreads == 0) {
+		numThreads = glm::max(1u, thread::hardware_concurrency());
+	}
+	for (unsigned i = 0; i < numThreads; ++i) {
+		_queues.push_back(unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+	for (unsigned i = 0; i < numThreads; ++i) {
+		_threads.push_back(thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (auto worker = _threads.begin(); worker != _threads.end(); ++worker) {
+		worker->join();
+	}
+}
+
+void ThreadPool::ParallelFor(int count, const function<void(int)> &task)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	unique_lock<mutex> lock(_lock);
+	_task = &task;
+	_remaining = count;
+
+	// Give each worker a contiguous run of tasks to start with, neighbouring tasks (e.g. tiles)
+	// tend to cost about the same and touch the same objects
+	unsigned numQueues = (unsigned)_queues.size();
+	for (unsigned q = 0; q < numQueues; ++q) {
+		int begin = (int)((long long)count * q / numQueues);
+		int end = (int)((long long)count * (q + 1) / numQueues);
+		lock_guard<mutex> queueGuard(_queues[q]->lock);
+		for (int i = begin; i < end; ++i) {
+			_queues[q]->tasks.push_back(i);
+		}
+	}
+
+	_batch++;
+	_wake.notify_all();
+	_done.wait(lock, [this] { return _remaining == 0; });
+	_task = NULL;
+}
+
+bool ThreadPool::NextTask(unsigned index, int &task)
+{
+	// Our own queue first, from the back
+	{
+		WorkQueue &own = *_queues[index];
+		lock_guard<mutex> guard(own.lock);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	// Then steal from the front of everyone else's
+	unsigned numQueues = (unsigned)_queues.size();
+	for (unsigned i = 1; i < numQueues; ++i) {
+		WorkQueue &victim = *_queues[(index + i) % numQueues];
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index)
+{
+	unsigned seenBatch = 0;
+	while (true) {
+		{
+			unique_lock<mutex> lock(_lock);
+			_wake.wait(lock, [&] { return _stop || _batch != seenBatch; });
+			if (_stop) {
+				return;
+			}
+			seenBatch = _batch;
+		}
+
+		// The queues are only filled after _task is set, so a task taken from them always
+		// belongs to the batch that _task points at
+		int task;
+		while (NextTask(index, task)) {
+			(*_task)(task);
+			if (--_remaining == 0) {
+				lock_guard<mutex> guard(_lock);
+				_done.notify_all();
+			}
+		}
+	}
+}
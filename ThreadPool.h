@@ -0,0 +1,53 @@
+#pragma once
+
+#include "header.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+
+//A fixed set of worker threads that share out batches of independent tasks
+//Each worker has its own queue of tasks. It takes work from the back of its own queue and, once that
+//runs dry, steals from the front of the other workers' queues so that no thread sits idle while
+//another still has a backlog (e.g. tiles full of mirrors take much longer than tiles of plain wall)
+class ThreadPool
+{
+public:
+	//Constructor
+	//@numThreads The number of worker threads, 0 means one per hardware thread
+	explicit ThreadPool(unsigned numThreads = 0);
+	~ThreadPool();
+
+	//Run task(0), task(1), ..., task(count - 1) across the workers and wait for all of them to finish
+	//Must not be called from inside a task
+	void ParallelFor(int count, const function<void(int)> &task);
+
+	//Returns the number of worker threads
+	unsigned NumThreads() const { return (unsigned)_threads.size(); }
+
+private:
+	//A worker's queue of task indices
+	struct WorkQueue
+	{
+		mutex lock;
+		deque<int> tasks;
+	};
+
+	void WorkerLoop(unsigned index);
+	//Take a task from the worker's own queue or, failing that, steal one from another queue
+	bool NextTask(unsigned index, int &task);
+
+	vector<thread> _threads;
+	vector<unique_ptr<WorkQueue>> _queues;
+
+	mutex _lock;
+	condition_variable _wake; // Signalled when a new batch of tasks is ready
+	condition_variable _done; // Signalled when the last task of a batch has finished
+	const function<void(int)> *_task; // The function being run for the current batch
+	atomic<int> _remaining; // Tasks of the current batch that have not finished yet
+	unsigned _batch; // Incremented for every batch so that workers can tell a new one has started
+	bool _stop;
+};
@@ -0,0 +1,113 @@
+#include "Timeline.h"
+
+#include <mutex>
+#include <thread>
+#include <cstdio>
+
+// The most events kept for one thread, after which further events are dropped rather than using up memory
+static const size_t kMaxEventsPerThread = 1 << 20;
+
+//The events recorded by one thread
+struct TimelineBuffer
+{
+	int id; // The order the threads first recorded an event in
+	bool mainThread; // The thread that started the timeline
+	vector<TimelineEvent> events;
+	size_t dropped; // Events not kept because the buffer was full
+};
+
+bool timelineEnabled = false;
+
+static string timelinePath;
+static chrono::steady_clock::time_point timelineStart;
+static thread::id timelineThread;
+
+// Every thread's buffer. Only locked when a thread records its first event and when the timeline is saved
+static mutex registryLock;
+static vector<unique_ptr<TimelineBuffer>> registry;
+
+void StartTimeline(const string &path)
+{
+	timelinePath = path;
+	timelineStart = chrono::steady_clock::now();
+	timelineThread = this_thread::get_id();
+	timelineEnabled = true;
+}
+
+long long TimelineNow()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timelineStart).count();
+}
+
+//Create the buffer for the calling thread
+static TimelineBuffer *NewTimelineBuffer()
+{
+	unique_ptr<TimelineBuffer> buffer(new TimelineBuffer());
+	buffer->mainThread = this_thread::get_id() == timelineThread;
+	buffer->events.reserve(1024);
+	buffer->dropped = 0;
+	lock_guard<mutex> guard(registryLock);
+	buffer->id = (int)registry.size();
+	registry.push_back(move(buffer));
+	return registry.back().get();
+}
+
+void RecordTimelineEvent(const TimelineEvent &event)
+{
+	static thread_local TimelineBuffer *buffer = NULL;
+	if (buffer == NULL) {
+		buffer = NewTimelineBuffer();
+	}
+	if (buffer->events.size() < kMaxEventsPerThread) {
+		buffer->events.push_back(event);
+	}
+	else {
+		++buffer->dropped;
+	}
+}
+
+bool SaveTimeline()
+{
+	if (!timelineEnabled) {
+		return true;
+	}
+	FILE *file = fopen(timelinePath.c_str(), "w");
+	if (file == NULL) {
+		cerr << "Could not write timeline " << timelinePath << endl;
+		return false;
+	}
+
+	// Complete ("X") events with their times in microseconds, after a name for each thread
+	lock_guard<mutex> guard(registryLock);
+	const char *separator = "\n";
+	size_t numEvents = 0;
+	fprintf(file, "{\"traceEvents\": [");
+	for (size_t i = 0; i < registry.size(); ++i) {
+		const TimelineBuffer &buffer = *registry[i];
+		fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s %d\"}}",
+		        separator, buffer.id, buffer.mainThread ? "Main thread" : "Thread", buffer.id);
+		separator = ",\n";
+		for (size_t e = 0; e < buffer.events.size(); ++e) {
+			const TimelineEvent &event = buffer.events[e];
+			fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+			        event.name, buffer.id, event.start / 1000.0, event.duration / 1000.0);
+			if (event.argName != NULL) {
+				fprintf(file, ", \"args\": {\"%s\": %d}", event.argName, event.arg);
+			}
+			fprintf(file, "}");
+		}
+		numEvents += buffer.events.size();
+		if (buffer.dropped > 0) {
+			cerr << "Timeline: dropped " << buffer.dropped << " events of thread " << buffer.id << endl;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		cerr << "Could not write timeline " << timelinePath << endl;
+		return false;
+	}
+	cout << "Saved timeline of " << numEvents << " events to " << timelinePath << endl;
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "header.h"
+
+#include <chrono>
+
+//A timeline of what each thread was doing, saved as a Chrome trace (JSON) that can be opened in chrome://tracing
+//or https://ui.perfetto.dev to see e.g. threads waiting for work or one tile holding up a frame
+//Recording is off until StartTimeline is called. Until then a TimelineScope only checks one flag, so the scopes
+//can be left in the render code. Each thread records its events into its own buffer without any locking and the
+//buffers are only put together when the timeline is saved
+
+//Set while events are being recorded. Only changed by StartTimeline, before any rendering starts
+extern bool timelineEnabled;
+
+//Start recording events
+//@path The file that SaveTimeline writes them to
+void StartTimeline(const string &path);
+
+//Write every event recorded so far to the file given to StartTimeline, e.g. when the program exits
+//Must only be called while no other thread is recording events
+//returns false if the file could not be written
+bool SaveTimeline();
+
+//One recorded event: something that one thread spent some time doing
+struct TimelineEvent
+{
+	const char *name; // Shown on the event. Must be a string that outlives the timeline, e.g. a literal
+	const char *argName; // If not NULL, the event is shown with arg under this name
+	int arg;
+	long long start; // Nanoseconds from StartTimeline
+	long long duration; // Nanoseconds
+};
+
+//Add an event to the calling thread's buffer
+void RecordTimelineEvent(const TimelineEvent &event);
+
+//Returns the time since StartTimeline in nanoseconds
+long long TimelineNow();
+
+//Records an event covering the time from its construction to its destruction, if the timeline is on
+class TimelineScope
+{
+public:
+	//@name Shown on the event. Must outlive the timeline, e.g. a literal
+	//@argName, arg An optional value to show with the event, e.g. the number of a tile
+	explicit TimelineScope(const char *name, const char *argName = NULL, int arg = 0)
+	{
+		_event.name = NULL;
+		if (timelineEnabled) {
+			_event.name = name;
+			_event.argName = argName;
+			_event.arg = arg;
+			_event.start = TimelineNow();
+		}
+	}
+
+	~TimelineScope()
+	{
+		if (_event.name != NULL) {
+			_event.duration = TimelineNow() - _event.start;
+			RecordTimelineEvent(_event);
+		}
+	}
+
+private:
+	TimelineScope(const TimelineScope &);
+	TimelineScope &operator =(const TimelineScope &);
+
+	TimelineEvent _event;
+};
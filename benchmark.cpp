@@ -0,0 +1,362 @@
+// Micro-benchmarks for the ray tracer, built and run with "make benchmark"
+// Measures how many rays per second each intersection test handles, for rays that hit and rays that miss, then
+// how long whole frames of the demo scenes take at several resolutions and with each order of tracing the pixels
+// (see PixelOrder). The results are printed as a table and can also be written as JSON (--json), so runs before and
+// after a change can be compared by a script
+#include "Scene.h"
+#include "Renderer.h"
+
+#include <chrono>
+#include <random>
+#include <cstdio>
+
+// The number of different rays each intersection test is run over
+static const int kNumRays = 4096;
+
+// The resolutions that the frames are rendered at
+static const int kFrameSizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+
+// The throughput of one intersection test
+struct PrimitiveResult
+{
+	string primitive; // e.g. sphere
+	string path; // object: Object::Intersect, store: the compiled scalar test, packet: the compiled SIMD test, which
+	             // includes packing the rays
+	string rays; // hit or miss
+	double hitRate; // The fraction of the rays that did hit, as a check on the ray set
+	double raysPerSecond;
+};
+
+// The time taken to render one frame
+struct FrameResult
+{
+	int scene;
+	string order; // The order the pixels were traced in, see PixelOrder
+	int width;
+	int height;
+	double seconds; // The fastest of the repeats
+	double raysPerSecond; // Primary rays, one per pixel
+};
+
+// Options from the command line
+struct BenchmarkOptions
+{
+	BenchmarkOptions():
+		minSeconds(0.2),
+		repeats(3),
+		quick(false)
+	{
+	}
+
+	double minSeconds; // Each intersection test is run for at least this long
+	int repeats; // Each frame is rendered this many times and the fastest is kept
+	bool quick; // Only render the frames at 640x480
+	string jsonPath; // Where to write the results as JSON, if anywhere
+};
+
+static double SecondsSince(const chrono::steady_clock::time_point &start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+//Run a test over and over for at least minSeconds
+//@test Tests every ray once and returns the number of hits
+//@hitRate Set to the fraction of rays that hit
+//returns the number of rays tested per second
+template<class F>
+static double RaysPerSecond(double minSeconds, F test, double &hitRate)
+{
+	long long rays = 0;
+	long long hits = 0;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	double seconds;
+	do {
+		hits += test();
+		rays += kNumRays;
+		seconds = SecondsSince(start);
+	} while (seconds < minSeconds);
+	hitRate = (double)hits / rays;
+	return rays / seconds;
+}
+
+//Make the rays for a primitive that fills the square from -1 to 1 around the origin in x and y
+//Hit rays start above the primitive and aim at the middle of it. Miss rays go straight past beside it, or for an
+//unbounded primitive (a plane) they point away from it
+//@hit Whether to make rays that hit or rays that miss
+//@unbounded True for a primitive that every downward ray hits
+static vector<Ray> MakeRays(bool hit, bool unbounded)
+{
+	mt19937 random(hit ? 1 : 2);
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	vector<Ray> rays;
+	rays.reserve(kNumRays);
+	for (int i = 0; i < kNumRays; ++i) {
+		if (hit) {
+			glm::vec3 origin(2.0f * unit(random), 2.0f * unit(random), 10.0f);
+			glm::vec3 target(0.25f * unit(random), 0.25f * unit(random), 0.0f);
+			rays.push_back(Ray(origin, glm::normalize(target - origin)));
+		}
+		else {
+			glm::vec3 origin(4.0f + unit(random), unit(random), 10.0f);
+			glm::vec3 direction(0.1f * unit(random), 0.1f * unit(random), unbounded ? 1.0f : -1.0f);
+			rays.push_back(Ray(origin, glm::normalize(direction)));
+		}
+	}
+	return rays;
+}
+
+//Benchmark one primitive through the object interface, the compiled scalar test and the compiled packet test
+//@name The name of the primitive in the results
+//@object The primitive, which fills the square from -1 to 1 around the origin in x and y
+//@kind The kind of primitive it compiles to
+//@compiledOnly Leave out the object path, for an object that is only traced in its compiled form
+static void BenchmarkPrimitive(const string &name, const Object &object, int kind, bool unbounded, bool compiledOnly,
+                               const BenchmarkOptions &options, vector<PrimitiveResult> &results)
+{
+	PrimitiveStore store;
+	object.Compile(store);
+
+	for (int hit = 1; hit >= 0; --hit) {
+		vector<Ray> rays = MakeRays(hit != 0, unbounded);
+
+		PrimitiveResult result;
+		result.primitive = name;
+		result.rays = hit ? "hit" : "miss";
+
+		if (!compiledOnly) {
+			result.path = "object";
+			result.raysPerSecond = RaysPerSecond(options.minSeconds, [&]() {
+				int hits = 0;
+				for (int i = 0; i < kNumRays; ++i) {
+					IntersectInfo info;
+					hits += object.Intersect(rays[i], info);
+				}
+				return hits;
+			}, result.hitRate);
+			results.push_back(result);
+		}
+
+		result.path = "store";
+		result.raysPerSecond = RaysPerSecond(options.minSeconds, [&]() {
+			int hits = 0;
+			for (int i = 0; i < kNumRays; ++i) {
+				PrimitiveHit primitiveHit;
+				hits += store.Intersect(kind, rays[i], 0, 1, primitiveHit);
+			}
+			return hits;
+		}, result.hitRate);
+		results.push_back(result);
+
+		// The rays are packed into each packet as they are tested, the same as the renderer does
+		result.path = "packet";
+		result.raysPerSecond = RaysPerSecond(options.minSeconds, [&]() {
+			int hits = 0;
+			for (int i = 0; i < kNumRays; i += kSimdWidth) {
+				SimdFloat time(std::numeric_limits<float>::infinity());
+				PrimitiveHit primitives[kSimdWidth];
+				int bits = store.IntersectPacket(kind, RayPacket(&rays[i], kSimdWidth), 0, 1, time, primitives).Bits();
+				for (int lane = 0; lane < kSimdWidth; ++lane) {
+					hits += (bits >> lane) & 1;
+				}
+			}
+			return hits;
+		}, result.hitRate);
+		results.push_back(result);
+	}
+}
+
+//Benchmark the quadratic solver that the sphere test is built on
+static void BenchmarkQuadratic(const BenchmarkOptions &options, vector<PrimitiveResult> &results)
+{
+	for (int hit = 1; hit >= 0; --hit) {
+		// Coefficients of a unit sphere test, with real roots for a hit and none for a miss
+		mt19937 random(3);
+		uniform_real_distribution<float> unit(0.0f, 1.0f);
+		vector<glm::vec3> coefficients;
+		for (int i = 0; i < kNumRays; ++i) {
+			float b = -2.0f - unit(random);
+			float c = hit ? 0.5f * unit(random) : 4.0f + unit(random);
+			coefficients.push_back(glm::vec3(1.0f, b, c));
+		}
+
+		PrimitiveResult result;
+		result.primitive = "quadratic";
+		result.path = "function";
+		result.rays = hit ? "hit" : "miss";
+		result.raysPerSecond = RaysPerSecond(options.minSeconds, [&]() {
+			int hits = 0;
+			for (int i = 0; i < kNumRays; ++i) {
+				float root0, root1;
+				hits += solveQuadraticEquation(coefficients[i].x, coefficients[i].y, coefficients[i].z, root0, root1);
+			}
+			return hits;
+		}, result.hitRate);
+		results.push_back(result);
+	}
+}
+
+//Render each demo scene at each resolution
+static void BenchmarkFrames(const BenchmarkOptions &options, ThreadPool &threadPool, vector<FrameResult> &results)
+{
+	RenderSettings settings;
+	vector<glm::vec3> framebuffer;
+	for (int number = 1; number <= 5; ++number) {
+		unique_ptr<Scene> scene = LoadDemoScene(number);
+		for (size_t size = 0; size < sizeof(kFrameSizes) / sizeof(kFrameSizes[0]); ++size) {
+			FrameResult result;
+			result.scene = number;
+			result.order = PixelOrderName(settings.pixelOrder);
+			result.width = kFrameSizes[size][0];
+			result.height = kFrameSizes[size][1];
+			if (options.quick && result.width != 640) {
+				continue;
+			}
+			result.seconds = std::numeric_limits<double>::infinity();
+			for (int repeat = 0; repeat < options.repeats; ++repeat) {
+				chrono::steady_clock::time_point start = chrono::steady_clock::now();
+				RenderImage(*scene, settings, result.width, result.height, framebuffer, threadPool);
+				result.seconds = glm::min(result.seconds, SecondsSince(start));
+			}
+			result.raysPerSecond = result.width * result.height / result.seconds;
+			results.push_back(result);
+			printf("scene %d %4dx%-4d %-8s %8.4f s %8.2f Mrays/s\n", result.scene, result.width, result.height,
+			       result.order.c_str(), result.seconds, result.raysPerSecond * 1e-6);
+		}
+	}
+}
+
+//Render each demo scene with each pixel order, at the largest resolution (640x480 with --quick)
+//Scalar and packet tracing are both measured since they walk the pixels of a tile differently
+static void BenchmarkOrders(const BenchmarkOptions &options, ThreadPool &threadPool, vector<FrameResult> &results)
+{
+	const int *size = kFrameSizes[options.quick ? 1 : sizeof(kFrameSizes) / sizeof(kFrameSizes[0]) - 1];
+	vector<glm::vec3> framebuffer;
+	for (int number = 1; number <= 5; ++number) {
+		unique_ptr<Scene> scene = LoadDemoScene(number);
+		for (int packets = 1; packets >= 0; --packets) {
+			for (int order = 0; order < kNumPixelOrders; ++order) {
+				RenderSettings settings;
+				settings.packetTracing = packets != 0;
+				settings.pixelOrder = (PixelOrder)order;
+				FrameResult result;
+				result.scene = number;
+				result.order = string(PixelOrderName(settings.pixelOrder)) + (packets ? "" : " scalar");
+				result.width = size[0];
+				result.height = size[1];
+				result.seconds = std::numeric_limits<double>::infinity();
+				for (int repeat = 0; repeat < options.repeats; ++repeat) {
+					chrono::steady_clock::time_point start = chrono::steady_clock::now();
+					RenderImage(*scene, settings, result.width, result.height, framebuffer, threadPool);
+					result.seconds = glm::min(result.seconds, SecondsSince(start));
+				}
+				result.raysPerSecond = result.width * result.height / result.seconds;
+				results.push_back(result);
+				printf("scene %d %4dx%-4d %-15s %8.4f s %8.2f Mrays/s\n", result.scene, result.width, result.height,
+				       result.order.c_str(), result.seconds, result.raysPerSecond * 1e-6);
+			}
+		}
+	}
+}
+
+//Write a list of frame results as JSON
+static void WriteFramesJson(FILE *file, const char *name, const vector<FrameResult> &frames)
+{
+	fprintf(file, "  \"%s\": [\n", name);
+	for (size_t i = 0; i < frames.size(); ++i) {
+		const FrameResult &result = frames[i];
+		fprintf(file, "    {\"scene\": %d, \"order\": \"%s\", \"width\": %d, \"height\": %d, \"seconds\": %.6f, \"mrays_per_sec\": %.3f}%s\n",
+		        result.scene, result.order.c_str(), result.width, result.height, result.seconds, result.raysPerSecond * 1e-6,
+		        i + 1 < frames.size() ? "," : "");
+	}
+	fprintf(file, "  ]");
+}
+
+//Write the results as JSON
+//returns false if the file could not be written
+static bool WriteJson(const string &path, unsigned numThreads, const vector<PrimitiveResult> &primitives,
+                      const vector<FrameResult> &frames, const vector<FrameResult> &orders)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == NULL) {
+		return false;
+	}
+	fprintf(file, "{\n  \"simd_width\": %d,\n  \"threads\": %u,\n  \"primitives\": [\n", kSimdWidth, numThreads);
+	for (size_t i = 0; i < primitives.size(); ++i) {
+		const PrimitiveResult &result = primitives[i];
+		fprintf(file, "    {\"primitive\": \"%s\", \"path\": \"%s\", \"rays\": \"%s\", \"hit_rate\": %.4f, \"mrays_per_sec\": %.3f}%s\n",
+		        result.primitive.c_str(), result.path.c_str(), result.rays.c_str(), result.hitRate,
+		        result.raysPerSecond * 1e-6, i + 1 < primitives.size() ? "," : "");
+	}
+	fprintf(file, "  ],\n");
+	WriteFramesJson(file, "frames", frames);
+	fprintf(file, ",\n");
+	WriteFramesJson(file, "orders", orders);
+	fprintf(file, "\n}\n");
+	return fclose(file) == 0;
+}
+
+static void PrintUsage(const char *program)
+{
+	cout << "Usage: " << program << " [options]" << endl;
+	cout << "  --json <file>  Also write the results to file as JSON" << endl;
+	cout << "  --quick        Shorter runs, and frames at 640x480 only" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--json" && i + 1 < argc) {
+			options.jsonPath = argv[++i];
+		}
+		else if (arg == "--quick") {
+			options.quick = true;
+			options.minSeconds = 0.05;
+			options.repeats = 1;
+		}
+		else {
+			PrintUsage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	Material material;
+	material.Klocal = 1.0f;
+	material.Kreflectivity = 0.0f;
+	Sphere sphere(1.0f, glm::vec3(0.0f), material);
+	Plane plane(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), material);
+	Triangle triangle(glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), material);
+	AxisAlignedBox box(glm::vec3(-1.0f), glm::vec3(1.0f), material);
+	TriangleMesh mesh(material);
+	mesh.AddTriangle(mesh.AddVertex(glm::vec3(-1.0f, -1.0f, 0.0f)), mesh.AddVertex(glm::vec3(1.0f, -1.0f, 0.0f)),
+	                 mesh.AddVertex(glm::vec3(0.0f, 1.0f, 0.0f)));
+
+	vector<PrimitiveResult> primitives;
+	BenchmarkPrimitive("sphere", sphere, kSphere, false, false, options, primitives);
+	BenchmarkPrimitive("plane", plane, kPlane, true, false, options, primitives);
+	BenchmarkPrimitive("triangle", triangle, kTriangle, false, false, options, primitives);
+	BenchmarkPrimitive("box", box, kBox, false, false, options, primitives);
+	BenchmarkPrimitive("mesh triangle", mesh, kMeshTriangle, false, true, options, primitives);
+	BenchmarkQuadratic(options, primitives);
+	for (size_t i = 0; i < primitives.size(); ++i) {
+		const PrimitiveResult &result = primitives[i];
+		printf("%-13s %-8s %-4s hit rate %5.3f %9.2f Mrays/s\n", result.primitive.c_str(), result.path.c_str(),
+		       result.rays.c_str(), result.hitRate, result.raysPerSecond * 1e-6);
+	}
+
+	ThreadPool threadPool;
+	vector<FrameResult> frames;
+	BenchmarkFrames(options, threadPool, frames);
+	vector<FrameResult> orders;
+	BenchmarkOrders(options, threadPool, orders);
+
+	if (!options.jsonPath.empty()) {
+		if (!WriteJson(options.jsonPath, threadPool.NumThreads(), primitives, frames, orders)) {
+			cerr << "Failed to write " << options.jsonPath << endl;
+			return 1;
+		}
+		cout << "Saved " << options.jsonPath << endl;
+	}
+	return 0;
+}
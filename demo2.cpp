@@ -1,527 +1,215 @@
 #include "demo2.h"
-#include "Ray.h"
-#include "Object.h"
+#include "Scene.h"
+#include "Renderer.h"
+#include "Image.h"
+#include "SceneFile.h"
+#include "SceneCache.h"
+#include "RenderStats.h"
+#include "Timeline.h"
+
+#include <chrono>
 
 //window resolution (default 640x480)
 int windowX = 640;
 int windowY = 480;
 
-//Camera matrices
-//For raytracer, only need camera transformation (View Matrix)
-glm::mat4 viewMatrix; //The transformation matrix for the virtual camera
-glm::vec3 originP = glm::vec3(0.0f, 0.0f, 200.0f);
-//float changer = 10.0f;
-
-
-// A container for all the objects in the scene
-vector<unique_ptr<Object>> objects;
-
-// The control panel variables - see below
-glm::vec3 lightPos;
-bool activateShadows;
-bool activatePhong;
-bool activateReflections;
-int maxReflections;
-//bool activateMovingCameraTest;
-int scene;
-
-//Perform any cleanup of resources here
-void cleanup()
+// The scene being rendered, built once at startup
+unique_ptr<Scene> scene;
+// The control panel settings - see LoadControlPanel
+RenderSettings settings;
+// Set with --scene on the command line to override the scene chosen in the control panel
+int sceneOverride = 0;
+// Set with --scene-file on the command line to render a scene read from a file instead of a demo scene
+string sceneFile;
+// Set with --scene-cache to render a scene saved earlier with --save-cache
+string sceneCache;
+// Set with --save-cache to save the scene to a scene cache once it is loaded
+string saveCache;
+// Set with --order to override the pixel order chosen in the control panel
+int orderOverride = -1;
+// Set with --aa to override the anti-aliasing grid chosen in the control panel
+int antialiasOverride = 0;
+// Set with --samples, --min-samples and --noise to override the adaptive sampling settings chosen in the control panel
+int maxSamplesOverride = 0;
+int minSamplesOverride = 0;
+float noiseOverride = 0.0f;
+// Set with --heatmap to also save false-colour images of what each pixel cost to trace in headless mode
+string heatmapPath;
+
+// The rendered colour of every pixel, stored row by row starting from the top left
+vector<glm::vec3> framebuffer;
+// The window is rendered a few tiles at a time from the GLUT idle callback so that it stays responsive
+ProgressiveRender progressiveRender;
+// How long each idle callback spends rendering before handing back to GLUT to handle input and redraw the window
+const double idleBudgetSeconds = 0.01;
+// How far each press of a light key moves the light
+const float lightStep = 10.0f;
+// Worker threads for rendering, one per core
+unique_ptr<ThreadPool> threadPool;
+
+#ifdef RT_STATS
+// Set with --stats-file to also write the statistics of every frame to a file, one line of JSON per frame
+ofstream statsFile;
+// The number of frames whose statistics have been reported
+int statsFrame = 0;
+// Set once a frame has finished rendering, so that DemoDisplay reports its statistics after drawing it
+bool statsPending = false;
+
+//Print the statistics of the frame that has just finished and start counting the next one
+void ReportFrameStats()
 {
-	objects.clear();
+	ReportRenderStats(++statsFrame, statsFile.is_open() ? &statsFile : NULL);
 }
+#endif
 
-
-
-//Forward declaration of functions, see below for more information
-bool CheckIntersection(const Ray &ray, IntersectInfo &info);
-float CastRay(Ray &ray, Payload &payload);
-
-//Function for testing for intersection with all the objects in the scene
-//If an object is hit then info contains the information on the intersection,
-//returns true if an object is hit, false otherwise
-bool CheckIntersection(const Ray &ray, IntersectInfo &info)
+//Perform any cleanup of resources here
+void cleanup()
 {
-	bool found = false;
-	// For each object in the scene
-	for (auto obj = objects.begin(); obj != objects.end(); ++obj) {
-		IntersectInfo tempInfo;
-		// Check if the ray intersects the object
-		if ((*obj)->Intersect(ray, tempInfo)) {
-			if (!found) {
-				found = true;
-				info = tempInfo;
-			}
-			else {
-				// Remember only the earliest collision
-				if (tempInfo.time < info.time) {
-					info = tempInfo;
-				}
-			}
-		}
-	}
-	return found;
+	threadPool.reset();
+	scene.reset();
+	// The render threads have finished, so every event is in
+	SaveTimeline();
 }
 
-//Recursive ray-casting function
-//Called for each pixel and each time a ray is reflected/used for shadow testing
-//@ray The ray we are casting
-//@payload Information on the current ray i.e. the cumulative color and the number of bounces it has performed
-//returns either the time of intersection with an object (the coefficient t in the equation: RayPosition = RayOrigin + t*RayDirection) or zero to indicate no intersection
-float CastRay(Ray &ray, Payload &payload)
-{
-	//Check if the ray intersects something
-	IntersectInfo info;
-	if (CheckIntersection(ray, info)) {
-
-		// Move the collision point slightly up the normal to avoid shadow ray colliding again
-		glm::vec3 hitPoint_fix = info.hitPoint + (0.1f * info.normal);
-
-		// Initialize a normal vector pointing towards the light source
-		// PL = L - P
-		glm::vec3 lightVec = glm::normalize(glm::vec3(lightPos - hitPoint_fix));
-
-		if (activateShadows) {
-
-			Ray shadowRay( 	hitPoint_fix, 	//The origin of the ray we are casting
-			                lightVec		//The direction the ray is travelling in
-			             );
-			IntersectInfo shadowInfo;
-			// Cast the shadow ray
-			bool shadowed = CheckIntersection(shadowRay, shadowInfo);
-
-			float collisionDist = glm::distance(hitPoint_fix, shadowInfo.hitPoint);
-			float lightDist = glm::distance(hitPoint_fix, lightPos);
-			if (shadowed) {
-				if (collisionDist < lightDist) {
-					payload.shadowed = true;
-				}
-				else {
-					payload.shadowed = false;
-				}
-			}
-			else {
-				payload.shadowed = false;
-			}
-		}
-
-		if (activatePhong) {
-			// Compute Phong illumination
-			glm::vec3 normOut = info.normal;
-			if (glm::dot(lightVec, normOut) < 0) {
-				normOut = -1.0f * normOut;
-			}
-			glm::vec3 eyeVec = glm::normalize(ray.origin - hitPoint_fix);
-			// Intensity constants
-			float attenuationFactor = 0.0;
-			float light_source_intensity = 1.0;
-			float specular_intensity = info.material->specularExponent;
-
-			// Reflectivity constants
-			float diffuse_reflectivity = 0.6;
-			float specular_reflectivity = 0.8;
-
-			// Ambient lighting constant
-			float ambient_lighting = 0.1;
-
-			// Dot product : a . b = |a||b|cosø
-			// |lightVec| == |normOut| == 1
-			// So lightVec . normOut = cosø
-			float cosine_theta = glm::max(0.0f, abs(glm::dot(lightVec, normOut)));
-
-			// cos(a) = (2N(L.N)-L).V
-			float cosine_alpha = glm::max(0.0f, glm::dot(((2.0f * normOut * (glm::dot(lightVec, normOut))) - lightVec), eyeVec));
-
-			// Using the equations in the coursework pdf
-			float diff    = light_source_intensity * diffuse_reflectivity * cosine_theta;
-			float spec    = light_source_intensity * specular_reflectivity * pow(cosine_alpha, specular_intensity);
-			float ambient = ambient_lighting;
-			float all = (diff + spec + ambient);
-
-			glm::vec3 diffMat = info.material->diffuse;
-			glm::vec3 specMat = info.material->specular;
-			glm::vec3 ambMat = info.material->ambient;
-
-			// Only use the ambient lighting if the pixel is in shadow
-			if (payload.shadowed) {
-				diff = 0;
-				spec = 0;
-			}
-
-			// Calculate the RGB colour using the Material
-			float red_free = (diff * diffMat.x) + (spec * specMat.x) + (ambient * ambMat.x);
-			float green_free = (diff * diffMat.y) + (spec * specMat.y) + (ambient * ambMat.y);
-			float blue_free = (diff * diffMat.z) + (spec * specMat.z) + (ambient * ambMat.z);
-			
-			// Constrain the colour floats to [0,1]
-			float red   = glm::max(0.0f, glm::min(1.0f, red_free));
-			float green = glm::max(0.0f, glm::min(1.0f, green_free));
-			float blue  = glm::max(0.0f, glm::min(1.0f, blue_free));
-
-			//Toggles Phong on and off
-			payload.color = info.material->Klocal * glm::vec3(red, green, blue);
-		}
-		else {
-			if (activateShadows) {
-				if (payload.shadowed) {
-					payload.color = glm::vec3(0.0f);
-				}
-				else {
-					payload.color = info.material->Klocal * info.material->ambient;
-				}
-			}
-			else {
-				// No shadows and no Phong so just colour everything by its ambient colour
-				payload.color = info.material->Klocal * info.material->ambient;
-			}
-		}
-
-		// The recursive reflection rays - adapted from the lecture slides
-		if (activateReflections) {
-			payload.numBounces++;
-
-			if (info.material->Kreflectivity > 0 && payload.numBounces <= maxReflections) {
-				IntersectInfo bounceInfo;
-				// r = i - 2N(i.n)
-				glm::vec3 reflDir = glm::normalize(ray.direction - 2.0f * info.normal * (glm::dot(ray.direction, info.normal)));
-				Ray reflectionRay( 	hitPoint_fix, 	//The origin of the ray we are casting
-				                    reflDir		//The direction the ray is travelling in
-				                 );
-				Payload refPayload;
-				refPayload.numBounces = payload.numBounces;
-				CastRay(reflectionRay, refPayload);
-				payload.color += info.material->Kreflectivity * refPayload.color;
-
-			}
-		}
-
 
-		return info.time;
-	}
-	return 0.0f;
-}
 
-/*--- Display Function ---*/
-//The main display function.
-//This allows you to draw pixels onto the display by using GL_POINTS.
-//Drawn every time an update is required.
-//Students: This is the main file you'll need to modify or replace.
-//The idea with this example function is the following:
-//1)Clear the screen so we can draw a new frame
-//2)Cast a ray into the scene for each pixel on the screen and use the returned color to render the pixel
-//3)Flush the pipeline so that the instructions we gave are performed.
-void DemoDisplay()
+//Set up the render options and build the scene
+//Called once at startup, redrawing the window only traces the scene that is built here
+void LoadControlPanel()
 {
-	// Set up the materials used in the scene
-	Material white = Material();
-		white.ambient = glm::vec3(1, 1, 1);
-		white.diffuse = glm::vec3(1, 1, 1);
-		white.specular = glm::vec3(1, 1, 1);
-		white.specularExponent = 10;
-		white.Klocal = 0.9;
-		white.Kreflectivity = 0.1;
-
-	Material whiteAbsorb = Material();
-		whiteAbsorb.ambient = glm::vec3(1, 1, 1);
-		whiteAbsorb.diffuse = glm::vec3(1, 1, 1);
-		whiteAbsorb.specular = glm::vec3(1, 1, 1);
-		whiteAbsorb.specularExponent = 1;
-		whiteAbsorb.Klocal = 1.0;
-		whiteAbsorb.Kreflectivity = 0;
-
-	Material shinyGreen = Material();
-		shinyGreen.ambient = glm::vec3(0, 1, 0);
-		shinyGreen.diffuse = glm::vec3(0, 1, 0);
-		shinyGreen.specular = glm::vec3(1, 1, 1);
-		shinyGreen.specularExponent = 50;
-		shinyGreen.Klocal = 0.8;
-		shinyGreen.Kreflectivity = 0.2;
-
-	Material red = Material();
-		red.ambient = glm::vec3(1, 0, 0);
-		red.diffuse = glm::vec3(1, 0, 0);
-		red.specular = glm::vec3(1, 1, 1);
-		red.specularExponent = 10;
-		red.Klocal = 0.9;
-		red.Kreflectivity = 0.1;
-
-	Material blue = Material();
-		blue.ambient = glm::vec3(0, 0, 1);
-		blue.diffuse = glm::vec3(0, 0, 1);
-		blue.specular = glm::vec3(1, 1, 1);
-		blue.specularExponent = 10;
-		blue.Klocal = 0.9;
-		blue.Kreflectivity = 0.1;
-
-	Material yellow = Material();
-		yellow.ambient = glm::vec3(1, 1, 0);
-		yellow.diffuse = glm::vec3(1, 1, 0);
-		yellow.specular = glm::vec3(1, 1, 1);
-		yellow.specularExponent = 50;
-		yellow.Klocal = 1;
-		yellow.Kreflectivity = 0;
-
-	Material mirror = Material();
-		mirror.ambient = glm::vec3(1, 1, 1);
-		mirror.diffuse = glm::vec3(1, 1, 1);
-		mirror.specular = glm::vec3(1, 1, 1);
-		mirror.specularExponent = 50;
-		mirror.Klocal = 0;
-		mirror.Kreflectivity = 1;
-
-	Material greyMirror = Material();
-		greyMirror.ambient = glm::vec3(0.5, 0.5, 0.5);
-		greyMirror.diffuse = glm::vec3(0.5, 0.5, 0.5);
-		greyMirror.specular = glm::vec3(1, 1, 1);
-		greyMirror.specularExponent = 50;
-		greyMirror.Klocal = 0.4;
-		greyMirror.Kreflectivity = 0.6;
-
-	Material purple = Material();
-		purple.ambient = glm::vec3(1, 0, 1);
-		purple.diffuse = glm::vec3(1, 0, 1);
-		purple.specular = glm::vec3(1, 1, 1);
-		purple.specularExponent = 10;
-		purple.Klocal = 1;
-		purple.Kreflectivity = 0;
-
-	Material black = Material();
-		black.ambient = glm::vec3(0, 0, 0);
-		black.diffuse = glm::vec3(0, 0, 0);
-		black.specular = glm::vec3(1, 1, 1);
-		black.specularExponent = 10;
-		black.Klocal = 1;
-		black.Kreflectivity = 0;
-
-	Material pink = Material();
-		pink.ambient = glm::vec3(1, 0.7, 0.7);
-		pink.diffuse = glm::vec3(1, 0.7, 0.7);
-		pink.specular = glm::vec3(1, 1, 1);
-		pink.specularExponent = 10;
-		pink.Klocal = 1;
-		pink.Kreflectivity = 0;
-
 	//------------------------------------------------------------//
 	//                   CONTROL PANEL                            //
 	//------------------------------------------------------------//
-	// The position of the point light source
-	lightPos = glm::vec3(0, 50, 125);
 	// Turn on to send shadow rays and generate basic shadows
-	activateShadows = true;
+	settings.activateShadows = true;
 	// Turn on to activate local phong illumination
-	activatePhong = true;
+	settings.activatePhong = true;
 	// Turn on to generate and compute reflection rays
-	activateReflections = true;
+	settings.activateReflections = true;
 	// The maximum number of bounces for reflection rays
-	maxReflections = 5;
+	settings.maxReflections = 5;
+	// Reflections are ended once they can add less than this to a pixel (0 to always do maxReflections bounces)
+	settings.minThroughput = 1.0f / 256.0f;
+	// Turn on to continue the faint reflections at random rather than always ending them
+	settings.russianRoulette = false;
+	// Turn on to trace neighbouring primary and shadow rays together as SIMD packets
+	settings.packetTracing = true;
+	// The order the pixels are traced in (see PixelOrder in Renderer.h)
+	settings.pixelOrder = kHilbertOrder;
+	// Pixels on edges are traced again with this many by this many samples, e.g. 4 for 16 samples (1 to turn off)
+	settings.antialiasGrid = 1;
+	// How different neighbouring colours must be for the pixels to count as an edge
+	settings.antialiasThreshold = 0.1f;
+	// Above 1, sample every pixel adaptively with up to this many samples instead of one ray and edge anti-aliasing
+	settings.maxSamples = 1;
+	// The samples every pixel gets before it can stop
+	settings.minSamples = 8;
+	// A pixel stops once the standard error of its brightness is below this
+	settings.noiseThreshold = 1.0f / 256.0f;
 
 	// Select the scene you wish to view
-	scene = 1;
+	int sceneNumber = 1;
 	// 1 - The basic scene with a sphere, triangle and planes
 	// 2 - A scene with two spheres to test reflection
 	// 3 - A scene to test reflection behind the camera
 	// 4 - A box of mirrors to test bouncing reflections
 	// 5 - Test of the new AxisAlignedBox object
+	// The objects, light and camera of each scene are set up in LoadDemoScene (Scene.cpp)
+	// The same scenes are also in the scenes folder as scene files, which can be loaded with --scene-file
 	//------------------------------------------------------------//
-
-	// Create the objects for the given scene
-	switch (scene) {
-	// The standard scene with a shiny green sphere and a grey triangular mirror in a room
-	// The room has a red left hand wall, blue right hand wall and white ceiling/floor
-	// The backwall is a perfect mirror
-	case 1 : {
-		// Planes
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror))); // Backwall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red))); // RHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue))); // LHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white))); // floor
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb))); // ceiling
-
-		// Spheres
-		objects.push_back(unique_ptr<Object>(new Sphere(30, glm::vec3(40, -30, 70), shinyGreen)));
-
-		// Triangles
-		objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-30, -60, 100),  glm::vec3(-0, -60, 60), glm::vec3(-40, -30, 80), greyMirror)));
-		break;
+	if (sceneOverride > 0) {
+		sceneNumber = sceneOverride;
 	}
-	// A large sphere of perfect mirror reflects a smaller red sphere
-	// Used to double check the reflections look correct
-	case 2 : {
-		// Planes
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), white))); // Backwall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red))); // RHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue))); // LHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white))); // floor
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb))); // ceiling
-
-		// Spheres
-		objects.push_back(unique_ptr<Object>(new Sphere(20, glm::vec3(0, -40, 150), red)));
-		objects.push_back(unique_ptr<Object>(new Sphere(40, glm::vec3(0, -20, 70), mirror)));
-
-		// Triangles
-		//objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen)));
-		break;
+	if (orderOverride >= 0) {
+		settings.pixelOrder = (PixelOrder)orderOverride;
 	}
-	// Create a 'face' for the viewer behind the camera which can only be seen by the reflection in the backwall and small
-	// triangular mirror
-	case 3 : {
-		// Planes
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror))); // Backwall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red))); // RHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue))); // LHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white))); // floor
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb))); // ceiling
-
-		// Spheres
-		objects.push_back(unique_ptr<Object>(new Sphere(30, glm::vec3(0, 0, 250), pink)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(0, 0, 220), pink)));
-		objects.push_back(unique_ptr<Object>(new Sphere(10, glm::vec3(-10, 10, 230), whiteAbsorb)));
-		objects.push_back(unique_ptr<Object>(new Sphere(10, glm::vec3(10, 10, 230), whiteAbsorb)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(-10, 10, 222), black)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(10, 10, 222), black)));
-
-		// Triangles
-		objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-30, -60, 140),  glm::vec3(-0, -60, 130), glm::vec3(-40, -30, 120), greyMirror)));
-		//objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen)));
-		break;
+	if (antialiasOverride > 0) {
+		settings.antialiasGrid = antialiasOverride;
 	}
-	// Shining a light into a mirrored box containing the basic pink 'face'
-	case 4 : {
-		lightPos = glm::vec3(0, 0, 200);
-		// Planes
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), greyMirror))); // Backwall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(40, 0, 0), glm::vec3(-1, 0, 0), greyMirror))); // RHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(-40, 0, 0), glm::vec3(1, 0, 0), greyMirror))); // LHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, -30, 0), glm::vec3(0, 1, 0), greyMirror))); // floor
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 30, 0), glm::vec3(0, -1, 0), greyMirror))); // ceiling
-
-		// Spheres
-		objects.push_back(unique_ptr<Object>(new Sphere(20, glm::vec3(0, -10, 100), pink)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(0, -10, 120), pink)));
-		objects.push_back(unique_ptr<Object>(new Sphere(10, glm::vec3(-10, 0, 110), whiteAbsorb)));
-		objects.push_back(unique_ptr<Object>(new Sphere(10, glm::vec3(10, 0, 110), whiteAbsorb)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(-10, 0, 118), black)));
-		objects.push_back(unique_ptr<Object>(new Sphere(5, glm::vec3(10, 0, 118), black)));
-
-		// Triangles
-		//objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-30,-60,140),  glm::vec3(-0,-60,130),glm::vec3(-40,-30,120), greyMirror)));
-		//objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-70,-60,80),  glm::vec3(-40,-60,120),glm::vec3(0,0,80), shinyGreen)));
-		break;
+	if (maxSamplesOverride > 0) {
+		settings.maxSamples = maxSamplesOverride;
 	}
-	// Test of additional feature - axis-aligned box
-	case 5 : {
-		// Planes
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 0, 0), glm::vec3(0, 0, 1), mirror))); // Backwall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(80, 0, 0), glm::vec3(-1, 0, 0), red))); // RHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(-80, 0, 0), glm::vec3(1, 0, 0), blue))); // LHS wall
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, -60, 0), glm::vec3(0, 1, 0), white))); // floor
-		objects.push_back(unique_ptr<Object>(new Plane(glm::vec3(0, 60, 0), glm::vec3(0, -1, 0), whiteAbsorb))); // ceiling
-
-		// Spheres
-		//objects.push_back(unique_ptr<Object>(new Sphere(30, glm::vec3(40,-30, 70), shinyGreen)));
-
-		// Triangles
-		//objects.push_back(unique_ptr<Object>(new Triangle(glm::vec3(-30,-60,100),  glm::vec3(-0,-60,60),glm::vec3(-40,-30,80), greyMirror)));
-
-		//Boxes
-		objects.push_back(unique_ptr<Object>(new AxisAlignedBox(glm::vec3(-50, -50, 100),  glm::vec3(-20, -20, 70), shinyGreen)));
-		break;
+	if (minSamplesOverride > 0) {
+		settings.minSamples = minSamplesOverride;
 	}
-	default :
-		break;
+	if (noiseOverride > 0.0f) {
+		settings.noiseThreshold = noiseOverride;
 	}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear OpenGL Window
-
-	//The window aspect ratio
-	float aspectRatio = (float)windowX / (float)windowY;
-	//The field of view of the camera.  This is 90 degrees because our imaginary image plane is 2 units high (-1->1) and 1 unit from the camera position
-	float fov = 90.0f;
-	//Value for adjusting the pixel position to account for the field of view
-	//float fovAdjust = tan(fov*0.5f *(M_PI/180.0f));
-	float fovAdjust = tan(fov * 0.5f * (3.14f / 180.0f));
-
-	//Tell OpenGL to start rendering points
-	glBegin(GL_POINTS);
-
-	//Set up our camera transformation matrices
-	viewMatrix = glm::translate(glm::mat4(1.0f), originP);
-
-	//Iterate over each pixel in the image
-	for (int column = 0; column < windowX; ++column) {
-
-		// if (column % (windowX / 20) == 0){
-		// 	float perc = (((float)column / (float)windowX)*100);
-		// 	cout << perc << "%" << endl;
-		// }
-
-		for (int row = 0; row < windowY; ++row) {
-
-			//Convert the pixel (Raster space coordinates: (0->ScreenWidth,0->ScreenHeight)) to NDC (Normalised Device Coordinates: (0->1,0->1))
-			float pixelNormX = (column + 0.5f) / windowX; //Add 0.5f to get centre of pixel
-			float pixelNormY = (row + 0.5f) / windowY;
-			//Convert from NDC, (0->1,0->1), to Screen space (-1->1,-1->1).  These coordinates correspond to those used by OpenGL
-			//Note coordinate (-1,1) in screen space corresponds to coordinate (0,0) in raster space i.e. column = 0, row = 0
-			float pixelScreenX = 2.0f * pixelNormX - 1.0f;
-			float pixelScreenY = 1.0f - 2.0f * pixelNormY;
-
-			//Account for Field of View
-			float pixelCameraX = pixelScreenX * fovAdjust;
-			float pixelCameraY = pixelScreenY * fovAdjust;
-
-			//Account for image aspect ratio
-			pixelCameraX *= aspectRatio;
-
-			//Put pixel into camera space (offset by 1 unit along camera facing direction i.e. negative z axis)
-			//vec4 so we can multiply with view matrix later
-			glm::vec4 pixelCameraSpace(pixelCameraX, pixelCameraY, -1.0f, 1.0f);
-
-			glm::vec4 rayOrigin(0.0f, 0.0f, 0.0f, 1.0f); //ray comes from camera origin
-
-			//Transform from camera space to world space
-			pixelCameraSpace = viewMatrix * pixelCameraSpace;
-			rayOrigin = viewMatrix * rayOrigin;
-			//rayOrigin = glm::vec4(0.0f,0.0f,200.0f,1.0f);
-			//cout << "rayOrigin " << glm::vec3(rayOrigin) << endl;
-			//Set up ray in world space
-			Ray ray(glm::vec3(rayOrigin), //The origin of the ray we are casting
-			        glm::normalize(glm::vec3(pixelCameraSpace - rayOrigin))//The direction the ray is travelling in
-			       );
+	// Leaves the scene empty if the file cannot be loaded
+	if (!sceneCache.empty()) {
+		scene = LoadSceneCache(sceneCache);
+		return;
+	}
+	if (!sceneFile.empty()) {
+		scene = LoadSceneFile(sceneFile);
+		return;
+	}
+	scene = LoadDemoScene(sceneNumber);
+}
 
-			//Structure for storing the information we get from casting the ray
-			Payload payload;
+#ifndef RT_HEADLESS
+/*--- Display Function ---*/
+//The main display function.
+//This allows you to draw pixels onto the display by copying the rendered image into the window.
+//Drawn every time an update is required.
+//Students: This is the main file you'll need to modify or replace.
+//The idea with this example function is the following:
+//1)Clear the screen so we can draw a new frame
+//2)Draw the image rendered so far with one glDrawPixels call. The rendering itself happens in DemoIdle
+//3)Flush the pipeline so that the instructions we gave are performed.
+void DemoDisplay()
+{
+	{
+		RT_STAT_TIME(kDrawPhase);
+		TimelineScope timelineScope("Draw");
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear OpenGL Window
 
-			//Default color is white
-			glm::vec3 color(1.0f);
+		//Copy the whole image to the window in one go, starting from the bottom left corner
+		glRasterPos2f(-1.0f, -1.0f);
+		glDrawPixels(windowX, windowY, GL_RGBA, GL_UNSIGNED_BYTE, &progressiveRender.displayPixels[0]);
 
-			//Cast our ray into the scene
-			float time = CastRay(ray, payload);
-			if (time > 0.0f) { // > 0.0f indicates an intersection
+		glFlush();// Output everything (write to the screen)
+	}
 
-				if (payload.shadowed) {
-					color = 1.0f * payload.color;
-				}
-				else {
-					float red = payload.color.x;
-					float blue = payload.color.y;
-					float green = payload.color.z;
-					color = glm::vec3(red, blue, green);
-				}
+#ifdef RT_STATS
+	if (statsPending) {
+		statsPending = false;
+		ReportFrameStats();
+	}
+#endif
+}
 
-			}
-			//Get OpenGL to render the pixel with the color from the ray
-			glColor3f(color.x, color.y, color.z);
-			glVertex3f(pixelScreenX, pixelScreenY, 0.0f);
+//Called by GLUT whenever it has no events waiting
+//Renders the frame in progress for a few milliseconds and then shows what has been done so far
+void DemoIdle()
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	do {
+		if (progressiveRender.Step(*scene, settings, *threadPool, threadPool->NumThreads())) {
+			glutIdleFunc(NULL); // Finished, so stop being called until the render is restarted
+#ifdef RT_STATS
+			statsPending = true;
+#endif
+			break;
 		}
-	}
-	glEnd();
+	} while (chrono::duration<double>(chrono::steady_clock::now() - start).count() < idleBudgetSeconds);
 
-	glFlush();// Output everything (write to the screen)
+	glutPostRedisplay();
+}
+
+//Throw away the frame in progress and start rendering it again from the coarsest pass
+void RestartRender()
+{
+	progressiveRender.Restart(windowX, windowY);
+	glutIdleFunc(DemoIdle);
 }
 
 
 //This function is called when a (normal) key is pressed
 //x and y give the mouse coordinates when a keyboard key is pressed
+//a/d, r/f and w/s move the light left/right, up/down and away/towards the camera. Only the lighting changes, so the
+//frame is shaded again from the primary hits of the last one rather than traced from scratch
 void DemoKeyboardHandler(unsigned char key, int x, int y)
 {
 	if (key == 'm')
@@ -531,8 +219,108 @@ void DemoKeyboardHandler(unsigned char key, int x, int y)
 
 	cout << "Key pressed: " << key << endl;
 
-	glutPostRedisplay();
+	static const char lightKeys[] = "adfrws";
+	const char *lightKey = strchr(lightKeys, key);
+	if (key != '\0' && lightKey != NULL) {
+		int index = (int)(lightKey - lightKeys);
+		glm::vec3 move(0.0f);
+		move[index / 2] = index % 2 == 0 ? -lightStep : lightStep;
+		scene->lightPos += move;
+		cout << "Light at " << scene->lightPos.x << " " << scene->lightPos.y << " " << scene->lightPos.z << endl;
+		progressiveRender.Relight();
+		glutIdleFunc(DemoIdle);
+		return;
+	}
 
+	RestartRender();
+
+}
+#endif
+
+//Save a heatmap of each of the costs of the pixels, e.g. heatmap.png is saved as heatmap-time.png,
+//heatmap-tests.png and heatmap-bounces.png
+//@path The image file name that the name of each cost is added to, the format is chosen by the extension
+//@costs The cost of each pixel, from RenderImage
+//returns false if an image could not be written
+bool WriteHeatmaps(const string &path, const vector<PixelCost> &costs)
+{
+	static const char *const names[kNumCostMetrics] = { "time", "tests", "bounces" };
+	static const char *const units[kNumCostMetrics] = { " s", " tests", " bounces" };
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && slash > dot)) {
+		dot = path.size();
+	}
+	vector<glm::vec3> image;
+	for (int metric = 0; metric < kNumCostMetrics; ++metric) {
+#ifndef RT_STATS
+		if (metric == kTestsCost) {
+			cout << "Intersection tests are only counted in a build with RT_STATS, so there is no heatmap of them" << endl;
+			continue;
+		}
+#endif
+		string metricPath = path.substr(0, dot) + "-" + names[metric] + path.substr(dot);
+		float fullScale = CostHeatmap(costs, (CostMetric)metric, image);
+		if (!WriteImage(metricPath, windowX, windowY, image)) {
+			cerr << "Failed to write " << metricPath << endl;
+			return false;
+		}
+		cout << "Saved " << metricPath << ", red is " << fullScale << units[metric] << " or more" << endl;
+	}
+	return true;
+}
+
+//Render a single frame and save it to disk without opening a window
+//@outputPath The image file to write, the format is chosen by the extension (.ppm, .pfm or .png)
+//returns the exit code for the program
+int RenderHeadless(const string &outputPath)
+{
+	vector<PixelCost> costs;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	RenderImage(*scene, settings, windowX, windowY, framebuffer, *threadPool, NULL, heatmapPath.empty() ? NULL : &costs);
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "Rendered " << windowX << "x" << windowY << " in " << seconds << " s" << endl;
+#ifdef RT_STATS
+	ReportFrameStats();
+#endif
+
+	{
+		TimelineScope timelineScope("Write image");
+		if (!WriteImage(outputPath, windowX, windowY, framebuffer)) {
+			cerr << "Failed to write " << outputPath << endl;
+			return 1;
+		}
+	}
+	cout << "Saved " << outputPath << endl;
+	if (!heatmapPath.empty() && !WriteHeatmaps(heatmapPath, costs)) {
+		return 1;
+	}
+	return 0;
+}
+
+//Print the command line options
+void PrintUsage(const char *program)
+{
+	cout << "Usage: " << program << " [options]" << endl;
+	cout << "  --headless        Render one frame to an image file instead of opening a window" << endl;
+	cout << "  --output <file>   Image to write in headless mode: .ppm, .pfm or .png (default render.ppm)" << endl;
+	cout << "  --scene <n>       Render scene n instead of the one chosen in the control panel" << endl;
+	cout << "  --scene-file <f>  Render the scene described in file f, see SceneFile.h for the format" << endl;
+	cout << "  --scene-cache <f> Render the scene saved in scene cache f" << endl;
+	cout << "  --save-cache <f>  Save the scene to scene cache f, which loads almost instantly with --scene-cache" << endl;
+	cout << "  --size <w>x<h>    Image resolution (default 640x480)" << endl;
+	cout << "  --order <order>   The order the pixels are traced in: column, row, tiled, morton or hilbert" << endl;
+	cout << "  --aa <n>          Anti-alias the edges with n by n samples per pixel, e.g. 4 for 16 samples" << endl;
+	cout << "  --samples <n>     Sample each pixel adaptively, with up to n samples where the image is still noisy" << endl;
+	cout << "  --min-samples <n> The samples every pixel gets before it can stop (default 8)" << endl;
+	cout << "  --noise <t>       Stop sampling a pixel once the standard error of its brightness is below t (default 1/256)" << endl;
+	cout << "  --heatmap <file>  In headless mode also save heatmaps of the time, intersection tests and bounces of each" << endl;
+	cout << "                    pixel, e.g. heat.png is saved as heat-time.png, heat-tests.png and heat-bounces.png" << endl;
+	cout << "  --timeline <file> Record what each thread does and save it on exit as a Chrome trace, for chrome://tracing" << endl;
+	cout << "                    or ui.perfetto.dev" << endl;
+#ifdef RT_STATS
+	cout << "  --stats-file <f>  Also write the statistics of every frame to file f, one line of JSON per frame" << endl;
+#endif
 }
 
 //Program entry point.
@@ -544,6 +332,123 @@ int main(int argc, char **argv)
 	atexit(cleanup);
 	cout << "Computer Graphics Assignment 2 Demo Program" << endl;
 
+	//Read the command line options
+#ifdef RT_HEADLESS
+	bool headless = true;
+#else
+	bool headless = false;
+#endif
+	string outputPath = "render.ppm";
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "--headless") {
+			headless = true;
+		}
+		else if (arg == "--output" && i + 1 < argc) {
+			outputPath = argv[++i];
+		}
+		else if (arg == "--scene" && i + 1 < argc) {
+			sceneOverride = atoi(argv[++i]);
+		}
+		else if (arg == "--scene-file" && i + 1 < argc) {
+			sceneFile = argv[++i];
+		}
+		else if (arg == "--scene-cache" && i + 1 < argc) {
+			sceneCache = argv[++i];
+		}
+		else if (arg == "--save-cache" && i + 1 < argc) {
+			saveCache = argv[++i];
+		}
+		else if (arg == "--order" && i + 1 < argc) {
+			string name = argv[++i];
+			for (int order = 0; order < kNumPixelOrders; ++order) {
+				if (name == PixelOrderName((PixelOrder)order)) {
+					orderOverride = order;
+				}
+			}
+			if (orderOverride < 0) {
+				cerr << "Unknown pixel order " << name << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--aa" && i + 1 < argc) {
+			antialiasOverride = atoi(argv[++i]);
+			if (antialiasOverride < 1 || antialiasOverride > 16) {
+				cerr << "Invalid anti-aliasing grid " << argv[i] << ", expected 1 to 16" << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--samples" && i + 1 < argc) {
+			maxSamplesOverride = atoi(argv[++i]);
+			if (maxSamplesOverride < 1) {
+				cerr << "Invalid sample count " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--min-samples" && i + 1 < argc) {
+			minSamplesOverride = atoi(argv[++i]);
+			if (minSamplesOverride < 2) {
+				cerr << "Invalid sample count " << argv[i] << ", expected at least 2" << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--noise" && i + 1 < argc) {
+			noiseOverride = (float)atof(argv[++i]);
+			if (noiseOverride <= 0.0f) {
+				cerr << "Invalid noise threshold " << argv[i] << endl;
+				return 1;
+			}
+		}
+		else if (arg == "--heatmap" && i + 1 < argc) {
+			heatmapPath = argv[++i];
+		}
+		else if (arg == "--timeline" && i + 1 < argc) {
+			StartTimeline(argv[++i]);
+		}
+#ifdef RT_STATS
+		else if (arg == "--stats-file" && i + 1 < argc) {
+			statsFile.open(argv[++i]);
+			if (!statsFile) {
+				cerr << "Could not open " << argv[i] << endl;
+				return 1;
+			}
+		}
+#endif
+		else if (arg == "--size" && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &windowX, &windowY) != 2 || windowX <= 0 || windowY <= 0) {
+				cerr << "Invalid size " << argv[i] << ", expected <width>x<height>" << endl;
+				return 1;
+			}
+		}
+		else {
+			PrintUsage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	//Start the render threads
+	threadPool.reset(new ThreadPool());
+	cout << "Rendering with " << threadPool->NumThreads() << " threads" << endl;
+
+	chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+	{
+		TimelineScope timelineScope("Load scene");
+		LoadControlPanel();
+	}
+	if (!scene) {
+		return 1;
+	}
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+	cout << "Loaded scene with " << scene->NumObjects() << " objects in " << loadSeconds << " s" << endl;
+	if (!saveCache.empty() && !SaveSceneCache(*scene, saveCache)) {
+		return 1;
+	}
+
+	if (headless) {
+		return RenderHeadless(outputPath);
+	}
+
+#ifndef RT_HEADLESS
 	//initialise OpenGL
 	glutInit(&argc, argv);
 	//Define the window size with the size specifed at the top of this file
@@ -559,7 +464,11 @@ int main(int argc, char **argv)
 	glutDisplayFunc(DemoDisplay);// Callback function
 	//similarly for keyboard input
 	glutKeyboardFunc(DemoKeyboardHandler);
+	//Start rendering the first frame, it is drawn as it goes from the idle callback
+	RestartRender();
 
 	//Run the GLUT internal loop
 	glutMainLoop();// Display everything and wait
+#endif
+	return 0;
 }
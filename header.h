@@ -13,9 +13,12 @@
 #include <memory>
 #include <algorithm>
 
+// The headless build (make headless) renders straight to an image file and does not use OpenGL at all
+#ifndef RT_HEADLESS
 #include <GL/glut.h>
 // For macOS use bellow
 //#include <GLUT/glut.h>
+#endif
 
 
 #include "glm/glm.hpp"